@@ -0,0 +1,737 @@
+/*
+ * File: adns.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of an asynchronous DNS
+ *      client driven by epoll. Every query gets a random DNS ID from
+ *      getrandom() and a table maps each live ID back to its slot and
+ *      record type, so an off-path sender cannot predict the next ID
+ *      and late answers to a reused slot are dropped.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+
+#include "adns.h"
+
+#define ADNS_HEADER_SIZE 12
+#define ADNS_PACKET_SIZE 1232
+#define ADNS_TYPE_A 1
+#define ADNS_TYPE_AAAA 28
+#define ADNS_CLASS_IN 1
+#define ADNS_RCODE_NXDOMAIN 3
+#define ADNS_RESOLV_CONF "/etc/resolv.conf"
+#define ADNS_RCVBUF (1 << 20)
+#define ADNS_IDS 65536
+
+static long long adns_now_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint16_t adns_get16(const unsigned char* p){
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void adns_put16(unsigned char* p, uint16_t v){
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+/* Append name as DNS labels, returns bytes written or -1 */
+static int adns_encode_name(unsigned char* out, const char* name, size_t len){
+    size_t start = 0;
+    size_t i;
+    int pos = 0;
+
+    /* one trailing dot is allowed */
+    if(len > 0 && name[len - 1] == '.'){
+	len--;
+    }
+    if(len == 0 || len > 253){
+	return -1;
+    }
+
+    for(i=0; i<=len; i++){
+	if(i == len || name[i] == '.'){
+	    if(i == start || i - start > 63){
+		return -1;
+	    }
+	    out[pos++] = (unsigned char)(i - start);
+	    memcpy(out + pos, name + start, i - start);
+	    pos += i - start;
+	    start = i + 1;
+	}
+    }
+    out[pos++] = 0;
+
+    return pos;
+}
+
+/* Step over a possibly compressed name, returns new offset or -1 */
+static int adns_skip_name(const unsigned char* p, int n, int off){
+    while(off < n){
+	if(p[off] == 0){
+	    return off + 1;
+	}
+	if((p[off] & 0xC0) == 0xC0){
+	    return off + 2 <= n ? off + 2 : -1;
+	}
+	off += p[off] + 1;
+    }
+
+    return -1;
+}
+
+/* Compare an uncompressed question name to the query name */
+static int adns_name_matches(const unsigned char* p, int n, int off,
+			     const adns_query* query){
+    char name[ADNS_MAX_NAME + 1];
+    size_t len = 0;
+    size_t queryLen = query->nameLen;
+
+    while(off < n && p[off] != 0){
+	if((p[off] & 0xC0) || off + 1 + p[off] > n ||
+	   len + p[off] + 1 > ADNS_MAX_NAME){
+	    return 0;
+	}
+	if(len > 0){
+	    name[len++] = '.';
+	}
+	memcpy(name + len, p + off + 1, p[off]);
+	len += p[off];
+	off += p[off] + 1;
+    }
+
+    if(queryLen > 0 && query->name[queryLen - 1] == '.'){
+	queryLen--;
+    }
+
+    return len == queryLen && strncasecmp(name, query->name, len) == 0;
+}
+
+static void adns_unlink(adns* a, adns_query* query){
+    if(query->prev){
+	query->prev->next = query->next;
+    }
+    else{
+	a->oldest = query->next;
+    }
+    if(query->next){
+	query->next->prev = query->prev;
+    }
+    else{
+	a->newest = query->prev;
+    }
+    query->prev = NULL;
+    query->next = NULL;
+}
+
+/* Draw an unused random ID and map it to query's type
+ * Returns ADNS_SUCCESS or ADNS_FAILURE if the kernel gave no randomness
+ */
+static int adns_take_id(adns* a, adns_query* query, int typeBit){
+    uint16_t id;
+    ssize_t got;
+
+    do{
+	if(a->randomLeft == 0){
+	    got = getrandom(a->random, sizeof(a->random), 0);
+	    if(got != sizeof(a->random)){
+		perror("Error drawing DNS query IDs");
+		return ADNS_FAILURE;
+	    }
+	    a->randomLeft = ADNS_RANDOM_IDS;
+	}
+	id = a->random[--a->randomLeft];
+    } while(a->byId[id]);
+
+    a->byId[id] = (uint16_t)(((query - a->queries) << 1 | typeBit) + 1);
+    query->ids[typeBit] = id;
+    return ADNS_SUCCESS;
+}
+
+/* Forget the IDs of query's pending types */
+static void adns_drop_ids(adns* a, adns_query* query){
+    if(query->pending & ADNS_QUERY_A){
+	a->byId[query->ids[0]] = 0;
+    }
+    if(query->pending & ADNS_QUERY_AAAA){
+	a->byId[query->ids[1]] = 0;
+    }
+}
+
+/* Move a finished query's answer out and return the slot */
+static void adns_finish(adns* a, adns_query* query, adns_answer* answer){
+    *answer = query->answer;
+    answer->user = query->user;
+    answer->elapsedMs = adns_now_ms() - (query->deadline - a->timeoutMs);
+    if(answer->num_addrs > 0){
+	answer->status = ADNS_OK;
+    }
+    else if(query->nxdomain){
+	answer->status = ADNS_NOTFOUND;
+    }
+    else if(query->pending){
+	answer->status = ADNS_TIMEOUT;
+    }
+    else if(query->failed){
+	answer->status = ADNS_ERROR;
+    }
+    else{
+	/* name exists but has no addresses of the asked types */
+	answer->status = ADNS_NOTFOUND;
+    }
+
+    adns_unlink(a, query);
+    adns_drop_ids(a, query);
+    query->pending = 0;
+    query->next = a->free;
+    a->free = query;
+    a->inflight--;
+}
+
+/* Parse one response datagram into its query
+ * Returns the query if it is now complete, NULL otherwise
+ */
+static adns_query* adns_handle(adns* a, const unsigned char* p, int n){
+    adns_query* query;
+    int slot;
+    int typeBit;
+    int qdcount;
+    int ancount;
+    int off = ADNS_HEADER_SIZE;
+    int type;
+    int rdlen;
+    unsigned int ttl;
+    int i;
+
+    if(n < ADNS_HEADER_SIZE || !(p[2] & 0x80)){
+	return NULL;
+    }
+
+    /* find the query this answers, unknown IDs are dropped */
+    slot = a->byId[adns_get16(p)];
+    if(slot == 0){
+	return NULL;
+    }
+    slot--;
+    query = &a->queries[slot >> 1];
+    typeBit = slot & 1;
+
+    qdcount = adns_get16(p + 4);
+    ancount = adns_get16(p + 6);
+    if(qdcount != 1 || !adns_name_matches(p, n, off, query)){
+	return NULL;
+    }
+    off = adns_skip_name(p, n, off);
+    if(off < 0 || off + 4 > n){
+	return NULL;
+    }
+    off += 4;
+
+    a->byId[query->ids[typeBit]] = 0;
+    query->pending &= ~(typeBit ? ADNS_QUERY_AAAA : ADNS_QUERY_A);
+    if((p[3] & 0x0F) == ADNS_RCODE_NXDOMAIN){
+	query->nxdomain = 1;
+    }
+    else if(p[3] & 0x0F){
+	query->failed = 1;
+    }
+
+    /* collect A and AAAA records, following CNAMEs implicitly */
+    for(i=0; i<ancount; i++){
+	off = adns_skip_name(p, n, off);
+	if(off < 0 || off + 10 > n){
+	    break;
+	}
+	type = adns_get16(p + off);
+	ttl = ((unsigned int)p[off + 4] << 24) | (p[off + 5] << 16) |
+	    (p[off + 6] << 8) | p[off + 7];
+	rdlen = adns_get16(p + off + 8);
+	off += 10;
+	if(off + rdlen > n){
+	    break;
+	}
+	if(query->answer.num_addrs < ADNS_MAX_ADDRS &&
+	   ((type == ADNS_TYPE_A && rdlen == 4) ||
+	    (type == ADNS_TYPE_AAAA && rdlen == 16))){
+	    adns_addr* addr = &query->answer.addrs[query->answer.num_addrs++];
+	    addr->family = rdlen == 4 ? AF_INET : AF_INET6;
+	    memcpy(addr->addr, p + off, rdlen);
+	    if(ttl < query->answer.ttl){
+		query->answer.ttl = ttl;
+	    }
+	}
+	off += rdlen;
+    }
+
+    return query->pending ? NULL : query;
+}
+
+static int adns_send(adns* a, adns_query* query, uint16_t id, int qtype){
+    unsigned char packet[ADNS_HEADER_SIZE + ADNS_MAX_NAME + 6];
+    int len;
+
+    memset(packet, 0, ADNS_HEADER_SIZE);
+    adns_put16(packet, id);
+    packet[2] = 0x01;		/* recursion desired */
+    adns_put16(packet + 4, 1);	/* one question */
+
+    len = adns_encode_name(packet + ADNS_HEADER_SIZE,
+			   query->name, query->nameLen);
+    if(len < 0){
+	return ADNS_FAILURE;
+    }
+    len += ADNS_HEADER_SIZE;
+    adns_put16(packet + len, qtype);
+    adns_put16(packet + len + 2, ADNS_CLASS_IN);
+    len += 4;
+
+    if(send(a->sock, packet, len, 0) != len){
+	return ADNS_FAILURE;
+    }
+
+    return ADNS_SUCCESS;
+}
+
+int adns_parse_server(const char* str, struct sockaddr_storage* server,
+		      socklen_t* len){
+    struct sockaddr_in* sin = (struct sockaddr_in*)server;
+    struct sockaddr_in6* sin6 = (struct sockaddr_in6*)server;
+    char host[INET6_ADDRSTRLEN + 2];
+    const char* port = NULL;
+    const char* end;
+    size_t hostLen;
+
+    memset(server, 0, sizeof(*server));
+
+    if(str[0] == '['){
+	/* [ipv6]:port */
+	if(!(end = strchr(str, ']'))){
+	    return ADNS_FAILURE;
+	}
+	hostLen = end - str - 1;
+	str++;
+	if(end[1] == ':'){
+	    port = end + 2;
+	}
+    }
+    else if((end = strchr(str, ':')) && strchr(end + 1, ':') == NULL){
+	/* ipv4:port */
+	hostLen = end - str;
+	port = end + 1;
+    }
+    else{
+	hostLen = strlen(str);
+    }
+    if(hostLen >= sizeof(host)){
+	return ADNS_FAILURE;
+    }
+    memcpy(host, str, hostLen);
+    host[hostLen] = '\0';
+
+    if(inet_pton(AF_INET, host, &sin->sin_addr) == 1){
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(port ? atoi(port) : ADNS_PORT);
+	*len = sizeof(*sin);
+    }
+    else if(inet_pton(AF_INET6, host, &sin6->sin6_addr) == 1){
+	sin6->sin6_family = AF_INET6;
+	sin6->sin6_port = htons(port ? atoi(port) : ADNS_PORT);
+	*len = sizeof(*sin6);
+    }
+    else{
+	return ADNS_FAILURE;
+    }
+
+    return ADNS_SUCCESS;
+}
+
+int adns_default_server(struct sockaddr_storage* server, socklen_t* len){
+    FILE* fp = fopen(ADNS_RESOLV_CONF, "r");
+    char line[256];
+    char addr[INET6_ADDRSTRLEN];
+    int ret = ADNS_FAILURE;
+
+    if(!fp){
+	return ADNS_FAILURE;
+    }
+    while(fgets(line, sizeof(line), fp)){
+	if(sscanf(line, "nameserver %45s", addr) == 1 &&
+	   adns_parse_server(addr, server, len) == ADNS_SUCCESS){
+	    ret = ADNS_SUCCESS;
+	    break;
+	}
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+int adns_init(adns* a, const struct sockaddr* server, socklen_t len,
+	      int qtypes, int maxInflight, int timeoutMs){
+    struct epoll_event ev;
+    int rcvbuf = ADNS_RCVBUF;
+    int size = 1;
+    int i;
+
+    if(maxInflight <= 0){
+	maxInflight = ADNS_DEFAULT_INFLIGHT;
+    }
+    if(maxInflight > ADNS_MAX_INFLIGHT){
+	maxInflight = ADNS_MAX_INFLIGHT;
+    }
+    while(size < maxInflight){
+	size <<= 1;
+    }
+
+    a->qtypes = qtypes ? qtypes : ADNS_QUERY_A | ADNS_QUERY_AAAA;
+    a->timeoutMs = timeoutMs > 0 ? timeoutMs : ADNS_DEFAULT_TIMEOUT_MS;
+    a->maxInflight = size;
+    a->inflight = 0;
+    a->randomLeft = 0;
+    a->oldest = NULL;
+    a->newest = NULL;
+    a->queries = NULL;
+    a->byId = NULL;
+    a->epfd = -1;
+
+    /* one connected socket only accepts datagrams from the server */
+    a->sock = socket(server->sa_family, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if(a->sock < 0){
+	perror("Error creating DNS socket");
+	return ADNS_FAILURE;
+    }
+    /* answers for every query in flight may land at once */
+    setsockopt(a->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if(connect(a->sock, server, len)){
+	perror("Error connecting DNS socket");
+	close(a->sock);
+	return ADNS_FAILURE;
+    }
+
+    a->epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.fd = a->sock;
+    if(a->epfd < 0 || epoll_ctl(a->epfd, EPOLL_CTL_ADD, a->sock, &ev)){
+	perror("Error creating DNS epoll");
+	adns_cleanup(a);
+	return ADNS_FAILURE;
+    }
+
+    a->queries = calloc(size, sizeof(adns_query));
+    a->byId = calloc(ADNS_IDS, sizeof(uint16_t));
+    if(!a->queries || !a->byId){
+	perror("Error on adns Malloc");
+	adns_cleanup(a);
+	return ADNS_FAILURE;
+    }
+    a->free = NULL;
+    for(i=size-1; i>=0; i--){
+	a->queries[i].next = a->free;
+	a->free = &a->queries[i];
+    }
+
+    return ADNS_SUCCESS;
+}
+
+int adns_submit(adns* a, const char* name, size_t len, void* user){
+    adns_query* query = a->free;
+
+    if(!query || len > ADNS_MAX_NAME){
+	return ADNS_FAILURE;
+    }
+
+    query->user = user;
+    query->nxdomain = 0;
+    query->failed = 0;
+    query->nameLen = len;
+    memcpy(query->name, name, len);
+    query->name[len] = '\0';
+    query->answer.num_addrs = 0;
+    query->answer.ttl = ~0U;
+    query->pending = 0;
+
+    /* fresh random IDs for this use of the slot */
+    if(a->qtypes & ADNS_QUERY_A){
+	if(adns_take_id(a, query, 0)){
+	    return ADNS_FAILURE;
+	}
+	if(adns_send(a, query, query->ids[0], ADNS_TYPE_A)){
+	    a->byId[query->ids[0]] = 0;
+	    return ADNS_FAILURE;
+	}
+	query->pending |= ADNS_QUERY_A;
+    }
+    if(a->qtypes & ADNS_QUERY_AAAA &&
+       adns_take_id(a, query, 1) == ADNS_SUCCESS){
+	if(adns_send(a, query, query->ids[1], ADNS_TYPE_AAAA)){
+	    a->byId[query->ids[1]] = 0;
+	}
+	else{
+	    query->pending |= ADNS_QUERY_AAAA;
+	}
+    }
+    if(a->qtypes & ADNS_QUERY_AAAA && !(query->pending & ADNS_QUERY_AAAA)){
+	if(!query->pending){
+	    return ADNS_FAILURE;
+	}
+	/* settle for the A answer */
+	query->failed = 1;
+    }
+
+    /* take it off the free list, append to the in-flight list */
+    a->free = query->next;
+    query->deadline = adns_now_ms() + a->timeoutMs;
+    query->next = NULL;
+    query->prev = a->newest;
+    if(a->newest){
+	a->newest->next = query;
+    }
+    else{
+	a->oldest = query;
+    }
+    a->newest = query;
+    a->inflight++;
+
+    return ADNS_SUCCESS;
+}
+
+int adns_poll(adns* a, adns_answer* answers, int max, int timeoutMs){
+    unsigned char packet[ADNS_PACKET_SIZE];
+    struct epoll_event ev;
+    adns_query* query;
+    long long now;
+    int filled = 0;
+    int wait;
+    int n;
+
+    if(max <= 0){
+	return 0;
+    }
+
+    /* sleep no longer than the oldest query has left */
+    now = adns_now_ms();
+    wait = timeoutMs;
+    if(a->oldest){
+	if(a->oldest->deadline - now < wait){
+	    wait = a->oldest->deadline > now ? a->oldest->deadline - now : 0;
+	}
+    }
+
+    if(epoll_wait(a->epfd, &ev, 1, wait) < 0 && errno != EINTR){
+	perror("Error waiting on DNS socket");
+	return ADNS_FAILURE;
+    }
+
+    /* drain whatever has arrived */
+    while(filled < max){
+	n = recv(a->sock, packet, sizeof(packet), 0);
+	if(n < 0){
+	    break;
+	}
+	if((query = adns_handle(a, packet, n)) != NULL){
+	    adns_finish(a, query, &answers[filled++]);
+	}
+    }
+
+    /* expire queries past their deadline */
+    now = adns_now_ms();
+    while(filled < max && a->oldest && a->oldest->deadline <= now){
+	adns_finish(a, a->oldest, &answers[filled++]);
+    }
+
+    return filled;
+}
+
+int adns_inflight(adns* a){
+    return a->inflight;
+}
+
+void adns_cleanup(adns* a){
+    if(a->epfd >= 0){
+	close(a->epfd);
+	a->epfd = -1;
+    }
+    if(a->sock >= 0){
+	close(a->sock);
+	a->sock = -1;
+    }
+    free(a->queries);
+    a->queries = NULL;
+    free(a->byId);
+    a->byId = NULL;
+}
+
+/* Answer status as a util.h lookup status */
+static int adns_util_status(int status){
+    switch(status){
+    case ADNS_OK:
+	return UTIL_SUCCESS;
+    case ADNS_NOTFOUND:
+	return UTIL_NOTFOUND;
+    case ADNS_TIMEOUT:
+	return UTIL_TIMEOUT;
+    default:
+	return UTIL_FAILURE;
+    }
+}
+
+/* Copy answer addresses into addrs, dropping repeats
+ * Returns the number copied
+ */
+static int adns_to_addrs(const adns_answer* in, util_addr* addrs,
+			 int maxAddrs){
+    int n = 0;
+    int i;
+
+    for(i=0; i<in->num_addrs; i++){
+	n = util_addr_add(addrs, n, maxAddrs, in->addrs[i].family,
+			  in->addrs[i].addr);
+    }
+    return n;
+}
+
+static void adns_to_util(const adns_answer* in, util_answer* out){
+    out->user = in->user;
+    out->status = adns_util_status(in->status);
+    out->elapsedMs = in->elapsedMs;
+    out->num_addrs = adns_to_addrs(in, out->addrs, UTIL_MAX_ADDRS);
+}
+
+static int adns_backend_open(util_backend* b, const char* arg){
+    adns_server* server = malloc(sizeof(adns_server));
+
+    if(!server){
+	perror("Error on adns Malloc");
+	return UTIL_FAILURE;
+    }
+    if((arg ? adns_parse_server(arg, &server->addr, &server->len) :
+	adns_default_server(&server->addr, &server->len)) == ADNS_FAILURE){
+	fprintf(stderr, "No usable DNS server%s%s\n",
+		arg ? ": " : " in resolv.conf", arg ? arg : "");
+	free(server);
+	return UTIL_FAILURE;
+    }
+    b->state = server;
+
+    return UTIL_SUCCESS;
+}
+
+/* Query types for the backend's profile */
+static int adns_profile_qtypes(const util_backend* b){
+    return (util_profile_wants(&b->profile, AF_INET) ? ADNS_QUERY_A : 0) |
+	(util_profile_wants(&b->profile, AF_INET6) ? ADNS_QUERY_AAAA : 0);
+}
+
+/* One query on a throwaway engine */
+static int adns_backend_lookup(util_backend* b, const char* hostname,
+			       util_addr* addrs, int* num_addrs,
+			       int maxAddrs){
+    adns_server* server = b->state;
+    adns_answer answer;
+    adns engine;
+    int n;
+
+    if(adns_init(&engine, (struct sockaddr*)&server->addr, server->len,
+		 adns_profile_qtypes(b), 1, 0) == ADNS_FAILURE){
+	return UTIL_FAILURE;
+    }
+    if(adns_submit(&engine, hostname, strlen(hostname), NULL)
+       == ADNS_FAILURE){
+	adns_cleanup(&engine);
+	return UTIL_FAILURE;
+    }
+    do{
+	n = adns_poll(&engine, &answer, 1, ADNS_DEFAULT_TIMEOUT_MS);
+    }while(n == 0);
+    adns_cleanup(&engine);
+    if(n < 0){
+	return UTIL_FAILURE;
+    }
+
+    *num_addrs = adns_to_addrs(&answer, addrs, maxAddrs);
+
+    return adns_util_status(answer.status);
+}
+
+static int adns_backend_async_open(util_async* a){
+    adns_server* server = a->backend->state;
+    adns* engine = malloc(sizeof(adns));
+
+    if(!engine ||
+       adns_init(engine, (struct sockaddr*)&server->addr, server->len,
+		 adns_profile_qtypes(a->backend), a->maxInflight, 0)
+       == ADNS_FAILURE){
+	free(engine);
+	return UTIL_FAILURE;
+    }
+    a->state = engine;
+    a->maxInflight = engine->maxInflight;
+
+    return UTIL_SUCCESS;
+}
+
+static int adns_backend_submit(util_async* a, const char* name, size_t len,
+			       void* user){
+    return adns_submit(a->state, name, len, user) == ADNS_SUCCESS ?
+	UTIL_SUCCESS : UTIL_FAILURE;
+}
+
+/* Waits only for the first chunk, then takes what is ready */
+static int adns_backend_poll(util_async* a, util_answer* answers, int max,
+			     int timeoutMs){
+    adns_answer chunk[ADNS_POLL_CHUNK];
+    int filled = 0;
+    int n;
+    int i;
+
+    do{
+	n = adns_poll(a->state, chunk,
+		      max - filled < ADNS_POLL_CHUNK ?
+		      max - filled : ADNS_POLL_CHUNK,
+		      filled ? 0 : timeoutMs);
+	if(n < 0){
+	    return filled ? filled : UTIL_FAILURE;
+	}
+	for(i=0; i<n; i++){
+	    adns_to_util(&chunk[i], &answers[filled++]);
+	}
+    }while(n == ADNS_POLL_CHUNK && filled < max);
+
+    return filled;
+}
+
+static int adns_backend_inflight(util_async* a){
+    return adns_inflight(a->state);
+}
+
+static void adns_backend_async_close(util_async* a){
+    adns_cleanup(a->state);
+    free(a->state);
+}
+
+static void adns_backend_destroy(util_backend* b){
+    free(b->state);
+    b->state = NULL;
+}
+
+const util_backend_ops adns_backend_ops = {
+    "dns", adns_backend_open, adns_backend_lookup, adns_backend_async_open,
+    adns_backend_submit, adns_backend_poll, adns_backend_inflight,
+    adns_backend_async_close, adns_backend_destroy
+};
@@ -0,0 +1,144 @@
+/*
+ * File: adns.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for an asynchronous DNS client. Queries
+ *      are sent over one non-blocking UDP socket and answers are matched
+ *      back to them by query ID, so a single thread can keep hundreds of
+ *      lookups in flight. One engine is meant to be used by one thread.
+ *
+ */
+
+#ifndef ADNS_H
+#define ADNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "util.h"
+
+#define ADNS_FAILURE -1
+#define ADNS_SUCCESS 0
+
+/* Answer status */
+#define ADNS_OK 0
+#define ADNS_NOTFOUND 1
+#define ADNS_TIMEOUT 2
+#define ADNS_ERROR 3
+
+/* Record types to ask for */
+#define ADNS_QUERY_A 1
+#define ADNS_QUERY_AAAA 2
+
+#define ADNS_PORT 53
+#define ADNS_MAX_NAME 255
+#define ADNS_MAX_ADDRS 32
+#define ADNS_DEFAULT_INFLIGHT 256
+#define ADNS_MAX_INFLIGHT 4096
+#define ADNS_DEFAULT_TIMEOUT_MS 5000
+#define ADNS_POLL_CHUNK 16
+/* query IDs drawn from the kernel at a time */
+#define ADNS_RANDOM_IDS 128
+
+typedef struct adns_addr_s{
+    int family;
+    unsigned char addr[16];
+} adns_addr;
+
+typedef struct adns_answer_s{
+    void* user;
+    int status;
+    unsigned int ttl;
+    long long elapsedMs;
+    int num_addrs;
+    adns_addr addrs[ADNS_MAX_ADDRS];
+} adns_answer;
+
+typedef struct adns_query_s{
+    struct adns_query_s* prev;
+    struct adns_query_s* next;
+    void* user;
+    long long deadline;
+    /* IDs of the A and AAAA queries while they are pending */
+    uint16_t ids[2];
+    int pending;
+    int nxdomain;
+    int failed;
+    size_t nameLen;
+    char name[ADNS_MAX_NAME + 1];
+    adns_answer answer;
+} adns_query;
+
+typedef struct adns_s{
+    int sock;
+    int epfd;
+    int qtypes;
+    int timeoutMs;
+    int maxInflight;
+    int inflight;
+    adns_query* queries;
+    /* slot * 2 + type + 1 of each live ID, 0 for none */
+    uint16_t* byId;
+    uint16_t random[ADNS_RANDOM_IDS];
+    int randomLeft;
+    adns_query* free;
+    /* in-flight queries, oldest (earliest deadline) first */
+    adns_query* oldest;
+    adns_query* newest;
+} adns;
+
+/* Server of the "dns[:server]" resolver backend */
+typedef struct adns_server_s{
+    struct sockaddr_storage addr;
+    socklen_t len;
+} adns_server;
+
+/* Backend "dns[:server]", the first resolv.conf nameserver by default
+ * Asynchronous lookups each run their own engine
+ */
+extern const util_backend_ops adns_backend_ops;
+
+/* Function to read a server address as "ipv4[:port]" or
+ * "[ipv6]:port" or a bare ipv6 address
+ * Returns ADNS_SUCCESS or ADNS_FAILURE
+ */
+int adns_parse_server(const char* str, struct sockaddr_storage* server,
+		      socklen_t* len);
+
+/* Function to take the first nameserver from /etc/resolv.conf
+ * Returns ADNS_SUCCESS or ADNS_FAILURE
+ */
+int adns_default_server(struct sockaddr_storage* server, socklen_t* len);
+
+/* Function to initilze a new engine talking to server
+ * qtypes is a mask of ADNS_QUERY_A and ADNS_QUERY_AAAA
+ * maxInflight is rounded up to a power of two, at most
+ * ADNS_MAX_INFLIGHT
+ * Returns ADNS_SUCCESS or ADNS_FAILURE
+ */
+int adns_init(adns* a, const struct sockaddr* server, socklen_t len,
+	      int qtypes, int maxInflight, int timeoutMs);
+
+/* Function to send a query for name
+ * user is handed back with the answer
+ * Returns ADNS_SUCCESS, or ADNS_FAILURE if the engine is full,
+ * the name is not a valid DNS name or the send failed
+ */
+int adns_submit(adns* a, const char* name, size_t len, void* user);
+
+/* Function to wait up to timeoutMs for answers
+ * Fills at most max answers, including timed out queries
+ * Returns the number filled or ADNS_FAILURE
+ */
+int adns_poll(adns* a, adns_answer* answers, int max, int timeoutMs);
+
+/* Function to count queries still waiting for an answer */
+int adns_inflight(adns* a);
+
+/* Function to close the engine, dropping queries in flight */
+void adns_cleanup(adns* a);
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ * File: adnsTest.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains test code for the asynchronous DNS
+ *      client, run against the loopback stub server, and for
+ *      deadline bounded lookups on the fake backend.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "adns.h"
+#include "dnsstub.h"
+#include "hedge.h"
+
+#define TEST_NAMES 300
+#define TEST_INFLIGHT 512
+#define TEST_TIMEOUT_MS 300
+#define TEST_POLL_MS 50
+#define TEST_SPOOF_TRIES 3
+/* fake lookups of 2 ms, 200 ms for slow* names, against 50 ms */
+#define TEST_FAKE_SPEC "fake:2000"
+#define TEST_DEADLINE_MS 50
+#define TEST_HELPERS 2
+#define TEST_SLOW 6
+#define TEST_FAST 20
+
+int main(int argc, char* argv[]){
+
+    /* Void Unused Variables */
+    (void) argc;
+    (void) argv;
+
+    /* Setup local vars */
+    dnsstub stub;
+    adns engine;
+    struct sockaddr_storage server;
+    socklen_t serverLen;
+    char server_str[32];
+    char names[TEST_NAMES + 2][32];
+    int seen[TEST_NAMES + 2];
+    adns_answer answers[64];
+    util_backend backend;
+    hedge hedger;
+    util_addr addrs[UTIL_MAX_ADDRS];
+    char ip[INET6_ADDRSTRLEN];
+    unsigned char expect[16];
+    int spoofer;
+    struct sockaddr_in spoofAddr;
+    struct sockaddr_storage client;
+    socklen_t clientLen;
+    unsigned char packet[512];
+    unsigned char reply[512];
+    uint16_t id;
+    int guessed;
+    int status;
+    int packetLen;
+    int replyLen;
+    int total = TEST_NAMES + 2;
+    int done = 0;
+    int errors = 0;
+    int i;
+    int n;
+    int idx;
+
+    /* Start Stub Server */
+    if(dnsstub_start(&stub) == DNSSTUB_FAILURE){
+	fprintf(stderr, "error: dnsstub_start failed!\n");
+	return 1;
+    }
+    sprintf(server_str, "127.0.0.1:%d", stub.port);
+
+    /* Initialize Engine */
+    if(adns_parse_server(server_str, &server, &serverLen) == ADNS_FAILURE ||
+       adns_init(&engine, (struct sockaddr*)&server, serverLen,
+		 ADNS_QUERY_A | ADNS_QUERY_AAAA, TEST_INFLIGHT,
+		 TEST_TIMEOUT_MS) == ADNS_FAILURE){
+	fprintf(stderr, "error: adns_init failed!\n");
+	dnsstub_stop(&stub);
+	return 1;
+    }
+
+    /* Test that invalid names are refused */
+    if(adns_submit(&engine, "bad..name", 9, NULL) != ADNS_FAILURE){
+	fprintf(stderr, "error: adns_submit accepted an empty label\n");
+	errors++;
+    }
+
+    /* Submit everything at once */
+    for(i=0; i<total; i++){
+	if(i == TEST_NAMES){
+	    strcpy(names[i], "nx.example.com");
+	}
+	else if(i == TEST_NAMES + 1){
+	    strcpy(names[i], "drop.example.com");
+	}
+	else{
+	    sprintf(names[i], "host%d.Example.com", i);
+	}
+	seen[i] = 0;
+	if(adns_submit(&engine, names[i], strlen(names[i]),
+		       (void*)(long)i) == ADNS_FAILURE){
+	    fprintf(stderr, "error: adns_submit failed!\n"
+		    "Name: %s\n", names[i]);
+	    errors++;
+	    seen[i] = 1;
+	    done++;
+	}
+    }
+    if(adns_inflight(&engine) != total - done){
+	fprintf(stderr, "error: adns_inflight reports %d, expected %d\n",
+		adns_inflight(&engine), total - done);
+	errors++;
+    }
+
+    /* Collect and check answers */
+    while(done < total){
+	if((n = adns_poll(&engine, answers, 64, TEST_POLL_MS)) < 0){
+	    fprintf(stderr, "error: adns_poll failed!\n");
+	    errors++;
+	    break;
+	}
+	for(i=0; i<n; i++){
+	    idx = (int)(long)answers[i].user;
+	    if(idx < 0 || idx >= total || seen[idx]){
+		fprintf(stderr, "error: unexpected or repeated answer %d\n",
+			idx);
+		errors++;
+		continue;
+	    }
+	    seen[idx] = 1;
+	    done++;
+
+	    if(idx == TEST_NAMES){
+		if(answers[i].status != ADNS_NOTFOUND){
+		    fprintf(stderr, "error: nx name not reported missing\n");
+		    errors++;
+		}
+		continue;
+	    }
+	    if(idx == TEST_NAMES + 1){
+		if(answers[i].status != ADNS_TIMEOUT){
+		    fprintf(stderr, "error: dropped name did not time out\n");
+		    errors++;
+		}
+		if(answers[i].elapsedMs < TEST_TIMEOUT_MS){
+		    fprintf(stderr, "error: timeout after only %lld ms\n",
+			    answers[i].elapsedMs);
+		    errors++;
+		}
+		continue;
+	    }
+
+	    /* stub answers on the name as sent */
+	    if(answers[i].status != ADNS_OK || answers[i].num_addrs != 2 ||
+	       answers[i].ttl != 300){
+		fprintf(stderr, "error: bad answer for %s: status %d, "
+			"%d addresses\n", names[idx], answers[i].status,
+			answers[i].num_addrs);
+		errors++;
+		continue;
+	    }
+	    dnsstub_address(names[idx], answers[i].addrs[0].family, expect);
+	    if(memcmp(expect, answers[i].addrs[0].addr,
+		      answers[i].addrs[0].family == AF_INET ? 4 : 16)){
+		fprintf(stderr, "error: answer for %s matched to the wrong "
+			"query\n", names[idx]);
+		errors++;
+	    }
+	}
+    }
+
+    if(adns_inflight(&engine) != 0){
+	fprintf(stderr, "error: queries left in flight\n");
+	errors++;
+    }
+
+    /* Test that answers with guessed IDs are dropped
+     * A socket of our own plays the server so it can send them */
+    spoofer = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&spoofAddr, 0, sizeof(spoofAddr));
+    spoofAddr.sin_family = AF_INET;
+    spoofAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverLen = sizeof(spoofAddr);
+    adns_cleanup(&engine);
+    if(spoofer < 0 ||
+       bind(spoofer, (struct sockaddr*)&spoofAddr, sizeof(spoofAddr)) ||
+       getsockname(spoofer, (struct sockaddr*)&spoofAddr, &serverLen) ||
+       adns_init(&engine, (struct sockaddr*)&spoofAddr, serverLen,
+		 ADNS_QUERY_A, TEST_INFLIGHT, TEST_TIMEOUT_MS) == ADNS_FAILURE){
+	fprintf(stderr, "error: spoof server did not start\n");
+	errors++;
+    }
+    else{
+	/* Guess the next ID from the last one as a counter would give it;
+	 * a random ID can still be guessed by chance, so allow one miss */
+	id = 0;
+	guessed = 0;
+	for(i=0; i<TEST_SPOOF_TRIES; i++){
+	    clientLen = sizeof(client);
+	    if(adns_submit(&engine, "spoof.example.com", 17, NULL)
+	       == ADNS_FAILURE ||
+	       (packetLen = recvfrom(spoofer, packet, sizeof(packet) - 32, 0,
+				     (struct sockaddr*)&client,
+				     &clientLen)) <= 0){
+		fprintf(stderr, "error: spoof query not sent\n");
+		errors++;
+		break;
+	    }
+	    memcpy(reply, packet, packetLen);
+	    replyLen = dnsstub_answer(reply, packetLen);
+	    guessed = 0;
+	    if(i > 0){
+		for(n=0; n<16; n++){
+		    reply[0] = (uint16_t)(id + (1 << n)) >> 8;
+		    reply[1] = (uint16_t)(id + (1 << n)) & 0xFF;
+		    guessed |= reply[0] == packet[0] && reply[1] == packet[1];
+		    sendto(spoofer, reply, replyLen, 0,
+			   (struct sockaddr*)&client, clientLen);
+		}
+		if(adns_poll(&engine, answers, 64, TEST_POLL_MS) != 0 &&
+		   !guessed){
+		    fprintf(stderr, "error: answer with a wrong ID accepted\n");
+		    errors++;
+		}
+	    }
+
+	    /* the real ID is answered, unless a guess already was */
+	    id = (packet[0] << 8) | packet[1];
+	    memcpy(reply, packet, 2);
+	    sendto(spoofer, reply, replyLen, 0,
+		   (struct sockaddr*)&client, clientLen);
+	    n = adns_poll(&engine, answers, 64, TEST_POLL_MS);
+	    if(!guessed && (n != 1 || answers[0].status != ADNS_OK)){
+		fprintf(stderr, "error: answer with the real ID dropped\n");
+		errors++;
+	    }
+	    if(i > 0 && !guessed){
+		break;
+	    }
+	}
+	if(guessed){
+	    fprintf(stderr, "error: query IDs follow a counter\n");
+	    errors++;
+	}
+    }
+    if(spoofer >= 0){
+	close(spoofer);
+    }
+
+    /* Test the dns backend's blocking lookup */
+    backend.ops = &adns_backend_ops;
+    util_profile_parse(&backend.profile, UTIL_DEFAULT_PROFILE);
+    if(adns_backend_ops.open(&backend, server_str) != UTIL_SUCCESS){
+	fprintf(stderr, "error: dns backend did not open\n");
+	errors++;
+    }
+    else{
+	if(adns_backend_ops.lookup(&backend, "one.example.com", addrs, &n,
+				   UTIL_MAX_ADDRS) != UTIL_SUCCESS || n != 2){
+	    fprintf(stderr, "error: dns backend lookup failed\n");
+	    errors++;
+	}
+	if(adns_backend_ops.lookup(&backend, "nx.example.com", addrs, &n,
+				   UTIL_MAX_ADDRS) != UTIL_NOTFOUND){
+	    fprintf(stderr, "error: dns backend found a missing name\n");
+	    errors++;
+	}
+
+	/* Test that an A-only profile sends no AAAA query */
+	util_profile_parse(&backend.profile, "a");
+	if(adns_backend_ops.lookup(&backend, "one.example.com", addrs, &n,
+				   UTIL_MAX_ADDRS) != UTIL_SUCCESS || n != 1 ||
+	   addrs[0].family != AF_INET){
+	    fprintf(stderr, "error: dns backend ignored the query profile\n");
+	    errors++;
+	}
+	adns_backend_ops.destroy(&backend);
+    }
+
+    /* Test that lookups abandoned at their deadline do not keep
+     * helpers from fast names that follow */
+    if(util_backend_open(&backend, TEST_FAKE_SPEC) != UTIL_SUCCESS ||
+       hedge_init(&hedger, &backend, NULL, TEST_DEADLINE_MS, TEST_HELPERS)
+       != HEDGE_SUCCESS){
+	fprintf(stderr, "error: hedge_init failed!\n");
+	errors++;
+    }
+    else{
+	for(i=0; i<TEST_SLOW + TEST_FAST; i++){
+	    sprintf(names[i], i < TEST_SLOW ? "slow%d.x" : "fast%d.x", i);
+	    status = hedge_lookup(&hedger, names[i], strlen(names[i]), addrs,
+				  &n, UTIL_MAX_ADDRS);
+	    if(status != (i < TEST_SLOW ? UTIL_TIMEOUT : UTIL_SUCCESS)){
+		fprintf(stderr, "error: %s gave status %d\n", names[i],
+			status);
+		errors++;
+	    }
+	}
+
+	/* Helpers Come Free Once The Slow Lookups Return */
+	for(i=0; hedge_cleanup(&hedger) == HEDGE_FAILURE; i++){
+	    if(i == TEST_TIMEOUT_MS){
+		fprintf(stderr, "error: hedge helpers never finished\n");
+		errors++;
+		break;
+	    }
+	    usleep(10000);
+	}
+	if(i < TEST_TIMEOUT_MS){
+	    util_backend_close(&backend);
+	}
+    }
+
+    /* Test that result addresses are kept once and formatted raw */
+    inet_pton(AF_INET, "10.0.0.1", expect);
+    n = util_addr_add(addrs, 0, 2, AF_INET, expect);
+    n = util_addr_add(addrs, n, 2, AF_INET, expect);
+    inet_pton(AF_INET6, "fd00::1", expect);
+    n = util_addr_add(addrs, n, 2, AF_INET6, expect);
+    n = util_addr_add(addrs, n, 2, AF_INET6, expect);
+    if(n != 2 || util_addr_format(&addrs[0], ip) != 8 ||
+       strcmp(ip, "10.0.0.1") != 0 ||
+       util_addr_format(&addrs[1], ip) != 7 || strcmp(ip, "fd00::1") != 0){
+	fprintf(stderr, "error: result addresses repeated or misformatted\n");
+	errors++;
+    }
+
+    /* Cleanup */
+    adns_cleanup(&engine);
+    dnsstub_stop(&stub);
+
+    if(errors){
+	fprintf(stderr, "adnsTest: %d errors\n", errors);
+    }
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * File: arena.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a chunked bump allocator
+ *      with per-chunk reference counts.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* Drop one reference, freeing the chunk on the last one */
+static void arena_chunk_put(arena_chunk* chunk){
+    if(__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0){
+	free(chunk);
+    }
+}
+
+static arena_chunk* arena_chunk_new(void){
+    void* mem = NULL;
+    arena_chunk* chunk;
+
+    if(posix_memalign(&mem, ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE)){
+	perror("Error on arena chunk Malloc");
+	return NULL;
+    }
+
+    /* the owner holds one reference until it moves on */
+    chunk = mem;
+    chunk->refs = 1;
+    chunk->used = sizeof(arena_chunk);
+
+    return chunk;
+}
+
+int arena_init(arena* a){
+    a->chunk = arena_chunk_new();
+
+    return a->chunk ? ARENA_SUCCESS : ARENA_FAILURE;
+}
+
+void* arena_alloc(arena* a, size_t size){
+    arena_chunk* chunk = a->chunk;
+    void* ptr;
+
+    if(size == 0 || size > ARENA_MAX_ALLOC){
+	return NULL;
+    }
+
+    /* start a new chunk when this one is full */
+    if(chunk->used + size > ARENA_CHUNK_SIZE){
+	if(!(chunk = arena_chunk_new())){
+	    return NULL;
+	}
+	arena_chunk_put(a->chunk);
+	a->chunk = chunk;
+    }
+
+    ptr = (char*)chunk + chunk->used;
+    chunk->used += (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    __atomic_add_fetch(&chunk->refs, 1, __ATOMIC_RELAXED);
+
+    return ptr;
+}
+
+char* arena_strndup(arena* a, const char* str, size_t len){
+    char* copy;
+
+    if(!(copy = arena_alloc(a, len + 1))){
+	return NULL;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    return copy;
+}
+
+void arena_release(void* ptr){
+    arena_chunk_put((arena_chunk*)((uintptr_t)ptr &
+				   ~(uintptr_t)(ARENA_CHUNK_SIZE - 1)));
+}
+
+void arena_cleanup(arena* a){
+    if(a->chunk){
+	arena_chunk_put(a->chunk);
+	a->chunk = NULL;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * File: arena.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a chunked bump allocator. One thread
+ *      owns an arena and allocates from it; any thread may release an
+ *      allocation. Each chunk is freed in one piece once its owner has
+ *      moved on and every allocation in it has been released.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_FAILURE -1
+#define ARENA_SUCCESS 0
+
+/* Chunks are aligned to their size so a pointer finds its chunk */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 8
+
+typedef struct arena_chunk_s{
+    int refs;
+    size_t used;
+} arena_chunk;
+
+typedef struct arena_s{
+    arena_chunk* chunk;
+} arena;
+
+/* Largest allocation a chunk can hold */
+#define ARENA_MAX_ALLOC (ARENA_CHUNK_SIZE - sizeof(arena_chunk))
+
+/* Function to initilze a new arena
+ * Returns ARENA_SUCCESS or ARENA_FAILURE
+ */
+int arena_init(arena* a);
+
+/* Function to allocate size bytes from the arena
+ * Only the owning thread may call this
+ * Returns NULL on failure or if size > ARENA_MAX_ALLOC
+ */
+void* arena_alloc(arena* a, size_t size);
+
+/* Function to copy len bytes of str into the arena
+ * and NUL terminate them
+ * Returns NULL on failure
+ */
+char* arena_strndup(arena* a, const char* str, size_t len);
+
+/* Function to release an allocation, from any thread */
+void arena_release(void* ptr);
+
+/* Function to drop the owner's hold on the arena
+ * Chunks still referenced are freed by the last arena_release
+ */
+void arena_cleanup(arena* a);
+
+#endif
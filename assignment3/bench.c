@@ -0,0 +1,311 @@
+/*
+ * File: bench.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains a benchmark for lookup and multi-lookup. It
+ *      writes synthetic input files, runs lookup and then multi-lookup
+ *      at each resolver count, all on the offline fake resolver backend
+ *      from fakedns.c, and prints names/sec, p50/p99
+ *      per-name lookup time and CPU time for each run. No network is
+ *      used.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define USAGE "[-n names] [-d dupPercent] [-x nxPercent] [-f files] [-l latencyUs] [-t threads,...]"
+#define OPTSTRING "n:d:x:f:l:t:"
+
+#define BENCH_NAMES 5000
+#define BENCH_DUP_PERCENT 50
+#define BENCH_NX_PERCENT 10
+#define BENCH_FILES 4
+#define BENCH_LATENCY_US "1000"
+#define BENCH_THREADS "1,2,4,8,16,32"
+#define BENCH_MAX_RUNS 16
+#define BENCH_SEED 3753
+#define BENCH_PATH 4096
+
+typedef struct bench_result_s{
+    double wallSec;
+    double cpuSec;
+    unsigned long samples;
+    unsigned int p50;
+    unsigned int p99;
+} bench_result;
+
+static int bench_compare(const void* a, const void* b){
+    unsigned int x = *(const unsigned int*)a;
+    unsigned int y = *(const unsigned int*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Write names across files, repeating earlier names dupPercent of the
+ * time and making nxPercent of new names ones that do not exist
+ * Returns 0 on success, -1 on failure
+ */
+static int bench_generate(const char* dir, int files, int names,
+			  int dupPercent, int nxPercent){
+    char path[BENCH_PATH];
+    FILE* fps[files];
+    unsigned int seed = BENCH_SEED;
+    int fresh = 0;
+    int id;
+    int f;
+    int i;
+
+    for(f=0; f<files; f++){
+	snprintf(path, sizeof(path), "%s/names%d.txt", dir, f);
+	fps[f] = fopen(path, "w");
+	if(!fps[f]){
+	    perror("Error Opening Bench Input");
+	    while(f-- > 0){
+		fclose(fps[f]);
+	    }
+	    return -1;
+	}
+    }
+
+    for(i=0; i<names; i++){
+	if(fresh > 0 && (int)(rand_r(&seed) % 100) < dupPercent){
+	    id = rand_r(&seed) % fresh;
+	}
+	else{
+	    id = fresh++;
+	}
+	/* the same id always gets the same name */
+	fprintf(fps[i % files], "%shost%d.bench\n",
+		(unsigned int)id * 2654435761U % 100 < (unsigned int)nxPercent ?
+		"nx" : "", id);
+    }
+
+    for(f=0; f<files; f++){
+	fclose(fps[f]);
+    }
+    return 0;
+}
+
+/* Run argv with its output discarded and read back the lookup log
+ * Returns 0 on success, -1 on failure
+ */
+static int bench_run(char* argv[], const char* log, bench_result* r){
+    struct timespec start;
+    struct timespec end;
+    struct rusage usage;
+    unsigned int* samples;
+    unsigned int* grown;
+    unsigned int sample;
+    size_t cap = 1024;
+    FILE* fp;
+    pid_t pid;
+    int status;
+    int devnull;
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if(pid < 0){
+	perror("Error forking benchmark run");
+	return -1;
+    }
+    if(pid == 0){
+	devnull = open("/dev/null", O_WRONLY);
+	dup2(devnull, STDOUT_FILENO);
+	dup2(devnull, STDERR_FILENO);
+	execv(argv[0], argv);
+	_exit(127);
+    }
+    if(wait4(pid, &status, 0, &usage) < 0){
+	perror("Error waiting on benchmark run");
+	return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	fprintf(stderr, "%s failed with status %d\n", argv[0], status);
+	return -1;
+    }
+
+    r->wallSec = (end.tv_sec - start.tv_sec) +
+	(end.tv_nsec - start.tv_nsec) / 1e9;
+    r->cpuSec = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+	usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    /* Per-Name Lookup Times */
+    r->samples = 0;
+    r->p50 = 0;
+    r->p99 = 0;
+    fp = fopen(log, "r");
+    if(!fp){
+	return 0;
+    }
+    samples = malloc(sizeof(unsigned int) * cap);
+    while(samples && fscanf(fp, "%u", &sample) == 1){
+	if(r->samples == cap){
+	    cap *= 2;
+	    grown = realloc(samples, sizeof(unsigned int) * cap);
+	    if(!grown){
+		free(samples);
+		samples = NULL;
+		break;
+	    }
+	    samples = grown;
+	}
+	samples[r->samples++] = sample;
+    }
+    fclose(fp);
+    unlink(log);
+    if(!samples){
+	perror("Error on bench Malloc");
+	return -1;
+    }
+
+    if(r->samples){
+	qsort(samples, r->samples, sizeof(unsigned int), bench_compare);
+	r->p50 = samples[r->samples / 2];
+	r->p99 = samples[r->samples * 99 / 100];
+    }
+    free(samples);
+
+    return 0;
+}
+
+static void bench_print(const char* tool, const char* threads, int names,
+			const bench_result* r){
+    printf("%-18s %7s %10.0f %8lu %8u %8u %9.3f\n", tool, threads,
+	   names / r->wallSec, r->samples, r->p50, r->p99, r->cpuSec);
+}
+
+int main(int argc, char* argv[]){
+
+    char dir[] = "/tmp/benchXXXXXX";
+    char log[BENCH_PATH];
+    char output[BENCH_PATH];
+    char inputs[BENCH_FILES * 4][BENCH_PATH];
+    char bounds[32];
+    char spec[64];
+    char threadList[BENCH_PATH] = BENCH_THREADS;
+    char* latency = BENCH_LATENCY_US;
+    char* cmd[BENCH_FILES * 4 + 8];
+    char* token;
+    bench_result r;
+    int names = BENCH_NAMES;
+    int dupPercent = BENCH_DUP_PERCENT;
+    int nxPercent = BENCH_NX_PERCENT;
+    int files = BENCH_FILES;
+    int runs = 0;
+    int rc = EXIT_SUCCESS;
+    int opt;
+    int c;
+    int f;
+
+    while((opt = getopt(argc, argv, OPTSTRING)) != -1){
+	switch(opt){
+	case 'n':
+	    names = atoi(optarg);
+	    break;
+	case 'd':
+	    dupPercent = atoi(optarg);
+	    break;
+	case 'x':
+	    nxPercent = atoi(optarg);
+	    break;
+	case 'f':
+	    files = atoi(optarg);
+	    break;
+	case 'l':
+	    latency = optarg;
+	    break;
+	case 't':
+	    snprintf(threadList, sizeof(threadList), "%s", optarg);
+	    break;
+	default:
+	    fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
+	    return EXIT_FAILURE;
+	}
+    }
+    if(names < 1 || files < 1 || files > BENCH_FILES * 4){
+	fprintf(stderr, "Need at least one name and 1 to %d files\n",
+		BENCH_FILES * 4);
+	return EXIT_FAILURE;
+    }
+
+    /* Generate Inputs */
+    if(!mkdtemp(dir)){
+	perror("Error creating bench directory");
+	return EXIT_FAILURE;
+    }
+    if(bench_generate(dir, files, names, dupPercent, nxPercent)){
+	rmdir(dir);
+	return EXIT_FAILURE;
+    }
+    for(f=0; f<files; f++){
+	snprintf(inputs[f], BENCH_PATH, "%s/names%d.txt", dir, f);
+    }
+    snprintf(output, sizeof(output), "%s/results.txt", dir);
+    snprintf(log, sizeof(log), "%s/lookups.log", dir);
+    snprintf(spec, sizeof(spec), "fake:%s", latency);
+    setenv("UTIL_BACKEND", spec, 1);
+    setenv("FAKEDNS_LOG", log, 1);
+
+    printf("%d names in %d files, %d%% repeats, %d%% missing, "
+	   "%s us per lookup\n", names, files, dupPercent, nxPercent, latency);
+    printf("%-18s %7s %10s %8s %8s %8s %9s\n", "tool", "threads",
+	   "names/s", "lookups", "p50 us", "p99 us", "cpu s");
+
+    /* Serial Baseline */
+    c = 0;
+    cmd[c++] = "./lookup";
+    for(f=0; f<files; f++){
+	cmd[c++] = inputs[f];
+    }
+    cmd[c++] = output;
+    cmd[c] = NULL;
+    if(bench_run(cmd, log, &r) == 0){
+	bench_print("lookup", "1", names, &r);
+    }
+    else{
+	rc = EXIT_FAILURE;
+    }
+
+    /* Fixed-Size Resolver Pools */
+    for(token = strtok(threadList, ","); token && runs < BENCH_MAX_RUNS;
+	token = strtok(NULL, ","), runs++){
+	snprintf(bounds, sizeof(bounds), "%d:%d", atoi(token), atoi(token));
+	c = 0;
+	cmd[c++] = "./multi-lookup";
+	cmd[c++] = "-p";
+	cmd[c++] = bounds;
+	for(f=0; f<files; f++){
+	    cmd[c++] = inputs[f];
+	}
+	cmd[c++] = output;
+	cmd[c] = NULL;
+	if(bench_run(cmd, log, &r) == 0){
+	    bench_print("multi-lookup", token, names, &r);
+	}
+	else{
+	    rc = EXIT_FAILURE;
+	}
+    }
+
+    /* Cleanup */
+    for(f=0; f<files; f++){
+	unlink(inputs[f]);
+    }
+    unlink(output);
+    unlink(log);
+    rmdir(dir);
+
+    return rc;
+}
@@ -0,0 +1,626 @@
+/*
+ * File: cache.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a sharded cache of lookup
+ *      results. Each shard is a chained hash table with its own mutex
+ *      and a condition variable for threads waiting on in-flight
+ *      lookups.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "stats.h"
+
+unsigned long cache_hash(const char* name, size_t len){
+    /* 64 bit FNV-1a */
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i;
+
+    for(i=0; i<len; i++){
+	h ^= (unsigned char)name[i];
+	h *= 1099511628211ULL;
+    }
+
+    return (unsigned long)(h ^ (h >> 32));
+}
+
+static long long cache_now_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static long long cache_real_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static cache_shard* cache_shard_for(cache* c, unsigned long hash){
+    /* high bits pick the shard, low bits the bucket */
+    return &c->shards[(hash >> 48) % CACHE_SHARDS];
+}
+
+/* Must hold shard lock */
+static cache_entry* cache_find(cache_shard* s, unsigned long hash,
+			       const char* name, size_t nameLen){
+    cache_entry* e;
+
+    for(e = s->buckets[hash & s->mask]; e != NULL; e = e->next){
+	if(e->hash == hash && e->nameLen == nameLen &&
+	   memcmp(e->name, name, nameLen) == 0){
+	    return e;
+	}
+    }
+
+    return NULL;
+}
+
+/* Must hold shard lock, doubles the bucket array */
+static void cache_grow(cache_shard* s){
+    size_t newMask = (s->mask << 1) | 1;
+    cache_entry** buckets = calloc(newMask + 1, sizeof(cache_entry*));
+    cache_entry* e;
+    cache_entry* next;
+    size_t i;
+
+    if(!buckets){
+	/* keep the longer chains */
+	return;
+    }
+
+    for(i=0; i<=s->mask; i++){
+	for(e = s->buckets[i]; e != NULL; e = next){
+	    next = e->next;
+	    e->next = buckets[e->hash & newMask];
+	    buckets[e->hash & newMask] = e;
+	}
+    }
+
+    free(s->buckets);
+    s->buckets = buckets;
+    s->mask = newMask;
+}
+
+/* Must hold shard lock, unlinks one finished entry no thread waits on
+ * A clock hand walks the buckets so eviction spreads over the table
+ * Returns 1 if an entry was evicted, 0 if every entry is in flight
+ */
+static int cache_evict(cache_shard* s){
+    cache_entry** link;
+    cache_entry* e;
+    size_t i;
+
+    for(i=0; i<=s->mask; i++){
+	link = &s->buckets[s->hand & s->mask];
+	s->hand++;
+	for(e = *link; e != NULL; link = &e->next, e = e->next){
+	    if(e->ready && e->waiters == 0){
+		*link = e->next;
+		free(e->result);
+		free(e);
+		s->count--;
+		return 1;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+/* Check the record at off lies inside the snapshot and its result
+ * fits the bound given to cache_load, records are 8 byte aligned
+ * Returns the record or NULL
+ */
+static const cache_snapshot_record* cache_snapshot_record_at(
+    const cache_snapshot* snap, unsigned long long off){
+    const cache_snapshot_record* rec;
+
+    if(off == 0 || (off & 7) ||
+       off > snap->size - sizeof(cache_snapshot_record)){
+	return NULL;
+    }
+    rec = (const cache_snapshot_record*)(snap->data + off);
+    if((unsigned long long)rec->nameLen + rec->resultLen >
+       snap->size - off - sizeof(cache_snapshot_record) ||
+       rec->resultLen > snap->maxResult){
+	return NULL;
+    }
+
+    return rec;
+}
+
+/* Find a name in the mapped snapshot, checking the record is sound
+ * Returns the record or NULL
+ */
+static const cache_snapshot_record* cache_snapshot_find(
+    const cache_snapshot* snap, unsigned long hash, const char* name,
+    size_t nameLen){
+    const cache_snapshot_record* rec;
+    unsigned long long i;
+    unsigned long long n;
+    unsigned long long off;
+
+    if(!snap->data){
+	return NULL;
+    }
+    for(i = hash & snap->mask, n = 0; n <= snap->mask;
+	i = (i + 1) & snap->mask, n++){
+	off = snap->slots[i].offset;
+	if(off == 0){
+	    return NULL;
+	}
+	if(snap->slots[i].hash != hash ||
+	   !(rec = cache_snapshot_record_at(snap, off))){
+	    continue;
+	}
+	if(rec->nameLen == nameLen &&
+	   memcmp(rec->data, name, nameLen) == 0){
+	    return rec;
+	}
+    }
+
+    return NULL;
+}
+
+/* Must hold shard lock, fills a new entry from the snapshot
+ * Returns 1 if it had an unexpired result of at most maxResult bytes,
+ * 0 otherwise
+ */
+static int cache_warm(cache* c, cache_entry* e, size_t maxResult){
+    const cache_snapshot_record* rec;
+    long long left;
+    char* copy;
+
+    rec = cache_snapshot_find(&c->snapshot, e->hash, e->name, e->nameLen);
+    if(!rec || rec->resultLen > maxResult){
+	return 0;
+    }
+    left = rec->expires - cache_real_ms();
+    if(left <= 0 || !(copy = malloc(rec->resultLen ? rec->resultLen : 1))){
+	return 0;
+    }
+    memcpy(copy, rec->data + rec->nameLen, rec->resultLen);
+    e->status = rec->status;
+    e->expires = cache_now_ms() + left;
+    e->result = copy;
+    e->resultLen = rec->resultLen;
+    e->ready = 1;
+
+    return 1;
+}
+
+int cache_init(cache* c){
+    cache_shard* s;
+    int i;
+
+    for(i=0; i<CACHE_SHARDS; i++){
+	s = &c->shards[i];
+	s->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(cache_entry*));
+	if(!s->buckets){
+	    perror("Error on cache Malloc");
+	    return CACHE_FAILURE;
+	}
+	s->mask = CACHE_INITIAL_BUCKETS - 1;
+	s->count = 0;
+	s->hand = 0;
+	if(pthread_mutex_init(&s->lock, NULL) ||
+	   pthread_cond_init(&s->done, NULL)){
+	    fprintf(stderr, "Error on cache mutex setup\n");
+	    return CACHE_FAILURE;
+	}
+    }
+
+    c->hits = 0;
+    c->misses = 0;
+    c->waits = 0;
+    c->expired = 0;
+    c->evicted = 0;
+    c->warm = 0;
+    c->limit = 0;
+    memset(&c->snapshot, 0, sizeof(c->snapshot));
+
+    return CACHE_SUCCESS;
+}
+
+void cache_set_limit(cache* c, size_t maxEntries){
+    c->limit = maxEntries / CACHE_SHARDS + 1;
+}
+
+int cache_acquire(cache* c, const char* name, size_t nameLen, int wait,
+		  int* status, char* buf, size_t bufSize, size_t* len){
+    unsigned long hash = cache_hash(name, nameLen);
+    cache_shard* s = cache_shard_for(c, hash);
+    cache_entry* e;
+    unsigned long long start;
+    int waited = 0;
+
+    stats_lock(&s->lock, STATS_CACHE_LOCK);
+
+    e = cache_find(s, hash, name, nameLen);
+    if(e == NULL){
+	/* first request, caller resolves it */
+	if(c->limit && s->count >= c->limit && cache_evict(s)){
+	    __atomic_add_fetch(&c->evicted, 1, __ATOMIC_RELAXED);
+	}
+	e = malloc(sizeof(cache_entry) + nameLen);
+	if(!e){
+	    pthread_mutex_unlock(&s->lock);
+	    return CACHE_FAILURE;
+	}
+	e->hash = hash;
+	e->ready = 0;
+	e->waiters = 0;
+	e->status = 0;
+	e->expires = CACHE_NO_EXPIRY;
+	e->result = NULL;
+	e->resultLen = 0;
+	e->nameLen = nameLen;
+	memcpy(e->name, name, nameLen);
+	e->next = s->buckets[hash & s->mask];
+	s->buckets[hash & s->mask] = e;
+	if(++s->count > s->mask){
+	    cache_grow(s);
+	}
+
+	/* an earlier run's snapshot may already have it */
+	if(!cache_warm(c, e, bufSize)){
+	    pthread_mutex_unlock(&s->lock);
+
+	    __atomic_add_fetch(&c->misses, 1, __ATOMIC_RELAXED);
+	    return CACHE_MISS;
+	}
+	__atomic_add_fetch(&c->warm, 1, __ATOMIC_RELAXED);
+    }
+
+    /* expired, caller resolves it again */
+    if(e->ready && e->expires != CACHE_NO_EXPIRY &&
+       cache_now_ms() >= e->expires){
+	e->ready = 0;
+	free(e->result);
+	e->result = NULL;
+	e->resultLen = 0;
+	pthread_mutex_unlock(&s->lock);
+
+	__atomic_add_fetch(&c->expired, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->misses, 1, __ATOMIC_RELAXED);
+	return CACHE_MISS;
+    }
+
+    /* in flight, wait for the owner */
+    if(!e->ready){
+	if(!wait){
+	    pthread_mutex_unlock(&s->lock);
+	    return CACHE_PENDING;
+	}
+	__atomic_add_fetch(&c->waits, 1, __ATOMIC_RELAXED);
+	start = stats_enabled() ? stats_now_ns() : 0;
+	waited = 1;
+	e->waiters++;
+	while(!e->ready){
+	    pthread_cond_wait(&s->done, &s->lock);
+	}
+	if(start){
+	    stats_record(STATS_CACHE_WAIT, stats_now_ns() - start, 1);
+	}
+    }
+
+    *status = e->status;
+    *len = e->resultLen < bufSize ? e->resultLen : bufSize;
+    if(*len){
+	memcpy(buf, e->result, *len);
+    }
+    if(waited){
+	e->waiters--;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    __atomic_add_fetch(&c->hits, 1, __ATOMIC_RELAXED);
+    return CACHE_HIT;
+}
+
+void cache_complete(cache* c, const char* name, size_t nameLen,
+		    int status, const char* result, size_t resultLen,
+		    long ttlMs){
+    unsigned long hash = cache_hash(name, nameLen);
+    cache_shard* s = cache_shard_for(c, hash);
+    cache_entry* e;
+    char* copy = malloc(resultLen ? resultLen : 1);
+
+    if(copy){
+	memcpy(copy, result, resultLen);
+    }
+    else{
+	/* waiters still need waking; they see an empty result */
+	resultLen = 0;
+    }
+
+    stats_lock(&s->lock, STATS_CACHE_LOCK);
+    e = cache_find(s, hash, name, nameLen);
+    if(e){
+	e->status = status;
+	e->expires = ttlMs == CACHE_NO_EXPIRY ?
+	    CACHE_NO_EXPIRY : cache_now_ms() + ttlMs;
+	e->result = copy;
+	e->resultLen = resultLen;
+	e->ready = 1;
+	copy = NULL;
+    }
+    pthread_cond_broadcast(&s->done);
+    pthread_mutex_unlock(&s->lock);
+
+    free(copy);
+}
+
+int cache_load(cache* c, const char* path, int format, int profile,
+	       unsigned long backend, size_t maxResult){
+    const cache_snapshot_header* h;
+    struct stat st;
+    void* data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+	return CACHE_FAILURE;
+    }
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(cache_snapshot_header)){
+	close(fd);
+	fprintf(stderr, "Cache snapshot %s is empty\n", path);
+	return CACHE_FAILURE;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+	perror("Error mapping cache snapshot");
+	return CACHE_FAILURE;
+    }
+
+    /* Only The Header Is Checked Now, Records As They Are Used */
+    h = data;
+    if(memcmp(h->magic, CACHE_SNAPSHOT_MAGIC, sizeof(h->magic)) ||
+       h->version != CACHE_SNAPSHOT_VERSION || h->format != format ||
+       h->profile != profile || h->backend != backend ||
+       h->slots == 0 || (h->slots & (h->slots - 1)) ||
+       h->slots > (st.st_size - sizeof(cache_snapshot_header)) /
+       sizeof(cache_snapshot_slot)){
+	fprintf(stderr, "Cache snapshot %s is from another version, "
+		"output format, profile or backend\n", path);
+	munmap(data, st.st_size);
+	return CACHE_FAILURE;
+    }
+    madvise(data, st.st_size, MADV_RANDOM);
+
+    c->snapshot.data = data;
+    c->snapshot.size = st.st_size;
+    c->snapshot.slots = (const cache_snapshot_slot*)(h + 1);
+    c->snapshot.mask = h->slots - 1;
+    c->snapshot.count = h->count;
+    c->snapshot.maxResult = maxResult;
+
+    return CACHE_SUCCESS;
+}
+
+/* One result on its way into a snapshot */
+typedef struct cache_save_item_s{
+    unsigned long hash;
+    const char* name;
+    size_t nameLen;
+    int status;
+    const char* result;
+    size_t resultLen;
+    long long expires;
+} cache_save_item;
+
+/* Append a result to a growing list
+ * Returns CACHE_SUCCESS or CACHE_FAILURE
+ */
+static int cache_save_add(cache_save_item** items, size_t* count,
+			  size_t* cap, const cache_save_item* item){
+    cache_save_item* grown;
+
+    if(*count == *cap){
+	*cap = *cap ? *cap * 2 : 1024;
+	grown = realloc(*items, sizeof(cache_save_item) * *cap);
+	if(!grown){
+	    perror("Error on cache snapshot Malloc");
+	    return CACHE_FAILURE;
+	}
+	*items = grown;
+    }
+    (*items)[(*count)++] = *item;
+    return CACHE_SUCCESS;
+}
+
+/* Bytes a record takes, padded so the next stays aligned */
+static size_t cache_record_size(const cache_save_item* item){
+    return (sizeof(cache_snapshot_record) + item->nameLen + item->resultLen
+	    + 7) & ~(size_t)7;
+}
+
+int cache_save(cache* c, const char* path, int format, int profile,
+	       unsigned long backend){
+    static const char pad[8] = { 0 };
+    const cache_snapshot_slot* slots = c->snapshot.slots;
+    const cache_snapshot_record* rec;
+    cache_snapshot_header h;
+    cache_snapshot_slot* table = NULL;
+    cache_snapshot_record out;
+    cache_save_item* items = NULL;
+    cache_save_item item;
+    cache_shard* s;
+    cache_entry* e;
+    char tmp[PATH_MAX];
+    long long mono = cache_now_ms();
+    long long real = cache_real_ms();
+    unsigned long long off;
+    unsigned long long j;
+    size_t count = 0;
+    size_t cap = 0;
+    size_t b;
+    size_t i;
+    int ret = CACHE_FAILURE;
+    FILE* fp = NULL;
+
+    /* Unexpired Results In Memory, Stamped With Wall Clock Expiry */
+    for(i=0; i<CACHE_SHARDS; i++){
+	s = &c->shards[i];
+	pthread_mutex_lock(&s->lock);
+	for(b=0; b<=s->mask; b++){
+	    for(e = s->buckets[b]; e != NULL; e = e->next){
+		if(!e->ready ||
+		   (e->expires != CACHE_NO_EXPIRY && e->expires <= mono)){
+		    continue;
+		}
+		item.hash = e->hash;
+		item.name = e->name;
+		item.nameLen = e->nameLen;
+		item.status = e->status;
+		item.result = e->result;
+		item.resultLen = e->resultLen;
+		item.expires = e->expires == CACHE_NO_EXPIRY ?
+		    real + CACHE_SNAPSHOT_TTL_MS : e->expires - mono + real;
+		if(cache_save_add(&items, &count, &cap, &item)){
+		    pthread_mutex_unlock(&s->lock);
+		    goto done;
+		}
+	    }
+	}
+	pthread_mutex_unlock(&s->lock);
+    }
+
+    /* Snapshot Results Not Looked Up This Run */
+    for(j=0; c->snapshot.data && j<=c->snapshot.mask; j++){
+	rec = cache_snapshot_record_at(&c->snapshot, slots[j].offset);
+	if(!rec || rec->expires <= real){
+	    continue;
+	}
+	s = cache_shard_for(c, slots[j].hash);
+	pthread_mutex_lock(&s->lock);
+	e = cache_find(s, slots[j].hash, rec->data, rec->nameLen);
+	pthread_mutex_unlock(&s->lock);
+	if(e){
+	    continue;
+	}
+	item.hash = slots[j].hash;
+	item.name = rec->data;
+	item.nameLen = rec->nameLen;
+	item.status = rec->status;
+	item.result = rec->data + rec->nameLen;
+	item.resultLen = rec->resultLen;
+	item.expires = rec->expires;
+	if(cache_save_add(&items, &count, &cap, &item)){
+	    goto done;
+	}
+    }
+
+    /* Open Addressed Table At Most Half Full */
+    memcpy(h.magic, CACHE_SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = CACHE_SNAPSHOT_VERSION;
+    h.format = format;
+    h.profile = profile;
+    h.backend = backend;
+    h.savedAt = real;
+    h.count = count;
+    for(h.slots = 16; h.slots < count * 2; h.slots <<= 1){
+    }
+    table = calloc(h.slots, sizeof(cache_snapshot_slot));
+    if(!table){
+	perror("Error on cache snapshot Malloc");
+	goto done;
+    }
+    off = sizeof(h) + h.slots * sizeof(cache_snapshot_slot);
+    for(i=0; i<count; i++){
+	for(j = items[i].hash & (h.slots - 1); table[j].offset != 0;
+	    j = (j + 1) & (h.slots - 1)){
+	}
+	table[j].offset = off;
+	table[j].hash = items[i].hash;
+	off += cache_record_size(&items[i]);
+    }
+
+    /* Write Beside The Old Snapshot, Which May Still Be Mapped */
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if(!fp){
+	perror("Error opening cache snapshot");
+	goto done;
+    }
+    fwrite(&h, sizeof(h), 1, fp);
+    fwrite(table, sizeof(cache_snapshot_slot), h.slots, fp);
+    for(i=0; i<count; i++){
+	out.nameLen = items[i].nameLen;
+	out.resultLen = items[i].resultLen;
+	out.status = items[i].status;
+	out.pad = 0;
+	out.expires = items[i].expires;
+	fwrite(&out, sizeof(out), 1, fp);
+	fwrite(items[i].name, 1, items[i].nameLen, fp);
+	fwrite(items[i].result, 1, items[i].resultLen, fp);
+	fwrite(pad, 1, cache_record_size(&items[i]) - sizeof(out) -
+	       items[i].nameLen - items[i].resultLen, fp);
+    }
+    if(ferror(fp) | fclose(fp)){
+	perror("Error writing cache snapshot");
+	unlink(tmp);
+	goto done;
+    }
+    if(rename(tmp, path)){
+	perror("Error replacing cache snapshot");
+	unlink(tmp);
+	goto done;
+    }
+    ret = CACHE_SUCCESS;
+
+ done:
+    free(table);
+    free(items);
+    return ret;
+}
+
+void cache_report(cache* c, FILE* fp){
+    fprintf(fp, "Cache: %lu hits, %lu misses (%lu expired), "
+	    "%lu waited on in-flight lookups, %lu evicted\n",
+	    c->hits, c->misses, c->expired, c->waits, c->evicted);
+    if(c->snapshot.data){
+	fprintf(fp, "Cache: %lu of %llu snapshot results reused\n",
+		c->warm, c->snapshot.count);
+    }
+}
+
+void cache_cleanup(cache* c){
+    cache_shard* s;
+    cache_entry* e;
+    cache_entry* next;
+    size_t b;
+    int i;
+
+    for(i=0; i<CACHE_SHARDS; i++){
+	s = &c->shards[i];
+	for(b=0; b<=s->mask; b++){
+	    for(e = s->buckets[b]; e != NULL; e = next){
+		next = e->next;
+		free(e->result);
+		free(e);
+	    }
+	}
+	free(s->buckets);
+	pthread_cond_destroy(&s->done);
+	pthread_mutex_destroy(&s->lock);
+    }
+    if(c->snapshot.data){
+	munmap((void*)c->snapshot.data, c->snapshot.size);
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ * File: cache.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a sharded, thread safe cache of
+ *      lookup results keyed by hostname. The first thread to ask for a
+ *      name owns its lookup; threads asking for the same name while the
+ *      lookup is in flight wait for it instead of repeating it.
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define CACHE_FAILURE -1
+#define CACHE_SUCCESS 0
+
+/* Results of cache_acquire */
+#define CACHE_HIT 1
+#define CACHE_MISS 0
+#define CACHE_PENDING 2
+
+/* ttl for results that never expire */
+#define CACHE_NO_EXPIRY -1
+
+#define CACHE_SHARDS 64
+#define CACHE_INITIAL_BUCKETS 256
+
+#define CACHE_SNAPSHOT_MAGIC "MLCS"
+#define CACHE_SNAPSHOT_VERSION 2
+/* how long a result that never expires is kept in a snapshot */
+#define CACHE_SNAPSHOT_TTL_MS (7LL * 24 * 60 * 60 * 1000)
+
+typedef struct cache_entry_s{
+    struct cache_entry_s* next;
+    unsigned long hash;
+    int ready;
+    /* threads waiting for it to be ready, it is not evicted while any */
+    int waiters;
+    int status;
+    long long expires;
+    char* result;
+    size_t resultLen;
+    size_t nameLen;
+    char name[];
+} cache_entry;
+
+typedef struct cache_shard_s{
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    cache_entry** buckets;
+    size_t mask;
+    size_t count;
+    /* next bucket to look in for an entry to evict */
+    size_t hand;
+} cache_shard;
+
+/* A snapshot file is this header, an open addressed table of slots
+ * (offset 0 is empty) and the records they point to, 8 byte aligned.
+ * Expiry stamps are wall clock ms so they survive a restart.
+ * Results depend on the query profile and backend, so both are kept.
+ */
+typedef struct cache_snapshot_header_s{
+    char magic[4];
+    unsigned int version;
+    int format;
+    int profile;
+    unsigned long long backend;
+    long long savedAt;
+    unsigned long long slots;
+    unsigned long long count;
+} cache_snapshot_header;
+
+typedef struct cache_snapshot_slot_s{
+    unsigned long long offset;
+    unsigned long long hash;
+} cache_snapshot_slot;
+
+typedef struct cache_snapshot_record_s{
+    unsigned int nameLen;
+    unsigned int resultLen;
+    int status;
+    int pad;
+    long long expires;
+    char data[];
+} cache_snapshot_record;
+
+/* A mapped snapshot, consulted on misses */
+typedef struct cache_snapshot_s{
+    const char* data;
+    size_t size;
+    const cache_snapshot_slot* slots;
+    unsigned long long mask;
+    unsigned long long count;
+    /* longest result a record may hold */
+    size_t maxResult;
+} cache_snapshot;
+
+typedef struct cache_s{
+    cache_shard shards[CACHE_SHARDS];
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long waits;
+    unsigned long expired;
+    unsigned long evicted;
+    unsigned long warm;
+    /* most entries per shard, 0 for no limit */
+    size_t limit;
+    cache_snapshot snapshot;
+} cache;
+
+/* Function to hash a name, shared with other hostname tables */
+unsigned long cache_hash(const char* name, size_t len);
+
+/* Function to initilze a new cache
+ * Returns CACHE_SUCCESS or CACHE_FAILURE
+ */
+int cache_init(cache* c);
+
+/* Function to bound the cache to about maxEntries names
+ * Past the bound each new name evicts a finished one from its shard
+ */
+void cache_set_limit(cache* c, size_t maxEntries);
+
+/* Function to look up a name
+ * On CACHE_HIT the stored status is set and up to bufSize bytes of the
+ * stored result are copied to buf, with the length copied in *len.
+ * If another thread is resolving the name, waits for it when wait is
+ * set and otherwise returns CACHE_PENDING so the caller can retry.
+ * On CACHE_MISS the caller owns the lookup and must call cache_complete;
+ * an expired result is a miss like any other.
+ * Returns CACHE_FAILURE if no entry could be created.
+ */
+int cache_acquire(cache* c, const char* name, size_t nameLen, int wait,
+		  int* status, char* buf, size_t bufSize, size_t* len);
+
+/* Function to store the result of a lookup owned after CACHE_MISS
+ * and wake any threads waiting on it
+ * The result expires ttlMs from now, or never for CACHE_NO_EXPIRY
+ */
+void cache_complete(cache* c, const char* name, size_t nameLen,
+		    int status, const char* result, size_t resultLen,
+		    long ttlMs);
+
+/* Function to map a snapshot written by cache_save
+ * Misses are then looked up in it before being reported as misses
+ * format, profile and backend must match the ones it was saved with
+ * Records that are truncated or hold more than maxResult bytes of
+ * result are skipped
+ * Returns CACHE_SUCCESS or CACHE_FAILURE if it is missing or unusable
+ */
+int cache_load(cache* c, const char* path, int format, int profile,
+	       unsigned long backend, size_t maxResult);
+
+/* Function to write every unexpired result, and those of a loaded
+ * snapshot not looked up since, to a snapshot at path
+ * Returns CACHE_SUCCESS or CACHE_FAILURE
+ */
+int cache_save(cache* c, const char* path, int format, int profile,
+	       unsigned long backend);
+
+/* Function to print hit/miss/expiry/eviction counts */
+void cache_report(cache* c, FILE* fp);
+
+/* Function to free cache memory */
+void cache_cleanup(cache* c);
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ * File: cacheTest.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains test code for the result cache: eviction
+ *      under a limit while threads wait on in-flight lookups, and
+ *      warming from snapshots with oversized or truncated records.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+#define TEST_ROUNDS 20
+#define TEST_WAITERS 8
+#define TEST_RESULT_SIZE 64
+#define TEST_SNAPSHOT "/tmp/cacheTest.XXXXXX"
+#define TEST_BIG_RESULT 100
+#define TEST_SMALL_RESULT 10
+/* a waiter reading a freed entry may wait forever */
+#define TEST_ALARM_SEC 30
+
+cache c;
+char waited_name[32];
+char waited_result[TEST_RESULT_SIZE];
+int waiter_errors = 0;
+
+/* Find a name of the form prefix<n> in the same shard as name */
+static void same_shard(const char* name, const char* prefix, char* out){
+    unsigned long want = (cache_hash(name, strlen(name)) >> 48) % CACHE_SHARDS;
+    int n;
+
+    for(n=0; ; n++){
+	sprintf(out, "%s%d", prefix, n);
+	if((cache_hash(out, strlen(out)) >> 48) % CACHE_SHARDS == want){
+	    return;
+	}
+    }
+}
+
+/* Store a result of len bytes for name in c */
+static void put(cache* c, const char* name, size_t len){
+    char result[TEST_BIG_RESULT];
+    char buf[TEST_BIG_RESULT];
+    size_t got;
+    int status;
+
+    memset(result, 'r', len);
+    if(cache_acquire(c, name, strlen(name), 1, &status, buf, sizeof(buf),
+		     &got) == CACHE_MISS){
+	cache_complete(c, name, strlen(name), 0, result, len,
+		       CACHE_NO_EXPIRY);
+    }
+}
+
+/* Load path into a fresh cache and look name up in it
+ * Returns the length found, or -1 if it was not warmed
+ */
+static long warm(const char* path, size_t maxResult, const char* name,
+		 size_t bufSize){
+    cache fresh;
+    char buf[TEST_BIG_RESULT];
+    size_t len;
+    int status;
+    long ret = -1;
+
+    if(cache_init(&fresh) == CACHE_FAILURE){
+	return -2;
+    }
+    if(cache_load(&fresh, path, 0, 0, 0, maxResult) == CACHE_SUCCESS &&
+       cache_acquire(&fresh, name, strlen(name), 1, &status, buf, bufSize,
+		     &len) == CACHE_HIT){
+	ret = len;
+    }
+    cache_cleanup(&fresh);
+
+    return ret;
+}
+
+/* Rewrite the result length of name's record in the snapshot at path
+ * Returns 0 or -1 if the record was not found
+ */
+static int set_result_len(const char* path, const char* name,
+			  unsigned int resultLen){
+    cache_snapshot_header h;
+    cache_snapshot_slot slot;
+    cache_snapshot_record rec;
+    char found[64];
+    unsigned long long i;
+    int fd = open(path, O_RDWR);
+    int ret = -1;
+
+    if(fd < 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h)){
+	return -1;
+    }
+    for(i=0; i<h.slots; i++){
+	if(pread(fd, &slot, sizeof(slot), sizeof(h) + i * sizeof(slot))
+	   != sizeof(slot) || slot.offset == 0 ||
+	   pread(fd, &rec, sizeof(rec), slot.offset) != sizeof(rec) ||
+	   rec.nameLen != strlen(name) ||
+	   pread(fd, found, rec.nameLen, slot.offset + sizeof(rec))
+	   != (ssize_t)rec.nameLen || memcmp(found, name, rec.nameLen)){
+	    continue;
+	}
+	rec.resultLen = resultLen;
+	if(pwrite(fd, &rec, sizeof(rec), slot.offset) == sizeof(rec)){
+	    ret = 0;
+	}
+	break;
+    }
+    close(fd);
+
+    return ret;
+}
+
+void* waiter(void* arg){
+    char buf[TEST_RESULT_SIZE];
+    size_t len;
+    int status;
+
+    (void) arg;
+
+    if(cache_acquire(&c, waited_name, strlen(waited_name), 1, &status,
+		     buf, sizeof(buf), &len) != CACHE_HIT ||
+       status != 0 || len != sizeof(waited_result) ||
+       memcmp(buf, waited_result, len) != 0){
+	__atomic_add_fetch(&waiter_errors, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]){
+
+    /* Void Unused Variables */
+    (void) argc;
+    (void) argv;
+
+    /* Setup local vars */
+    pthread_t threads[TEST_WAITERS];
+    char prefix[32];
+    char other[48];
+    cache_shard* s;
+    cache_entry* e;
+    size_t b;
+    char buf[TEST_RESULT_SIZE];
+    char path[sizeof(TEST_SNAPSHOT)];
+    struct stat st;
+    size_t len;
+    int status;
+    int errors = 0;
+    int fd;
+    int round;
+    int i;
+
+    alarm(TEST_ALARM_SEC);
+
+    /* Test that an entry with waiters is not evicted from under them
+     * One entry per shard and a fresh cache each round, so the miss
+     * on the other name can only evict the waited on entry */
+    for(round=0; round<TEST_ROUNDS; round++){
+	if(cache_init(&c) == CACHE_FAILURE){
+	    fprintf(stderr, "error: cache_init failed!\n");
+	    return 1;
+	}
+	cache_set_limit(&c, 0);
+	sprintf(waited_name, "waited%d.example", round);
+	same_shard(waited_name, "evictor.example", other);
+	memset(waited_result, 'a' + round % 26, sizeof(waited_result));
+	s = &c.shards[(cache_hash(waited_name, strlen(waited_name)) >> 48) %
+		      CACHE_SHARDS];
+
+	if(cache_acquire(&c, waited_name, strlen(waited_name), 1, &status,
+			 buf, sizeof(buf), &len) != CACHE_MISS){
+	    fprintf(stderr, "error: new name was not a miss\n");
+	    return 1;
+	}
+	for(i=0; i<TEST_WAITERS; i++){
+	    pthread_create(&threads[i], NULL, waiter, NULL);
+	}
+
+	/* Once The Lock Is Free Every Counted Waiter Is Parked */
+	while(__atomic_load_n(&c.waits, __ATOMIC_ACQUIRE) < TEST_WAITERS){
+	    usleep(100);
+	}
+
+	/* Complete It Without Waking Anyone, As Just After A Broadcast
+	 * Before The Waiters Get The Lock Back */
+	pthread_mutex_lock(&s->lock);
+	for(b=0; b<=s->mask; b++){
+	    for(e = s->buckets[b]; e; e = e->next){
+		e->result = malloc(sizeof(waited_result));
+		memcpy(e->result, waited_result, sizeof(waited_result));
+		e->resultLen = sizeof(waited_result);
+		e->ready = 1;
+	    }
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	/* A Miss In The Same Shard Must Not Free It, Completing That Miss
+	 * Wakes The Waiters */
+	if(cache_acquire(&c, other, strlen(other), 0, &status, buf,
+			 sizeof(buf), &len) == CACHE_MISS){
+	    cache_complete(&c, other, strlen(other), 0, "x", 1,
+			   CACHE_NO_EXPIRY);
+	}
+	if(c.evicted){
+	    fprintf(stderr, "error: entry evicted with %d waiters\n",
+		    TEST_WAITERS);
+	    return 1;
+	}
+
+	for(i=0; i<TEST_WAITERS; i++){
+	    pthread_join(threads[i], NULL);
+	}
+
+	/* With The Waiters Gone It Can Be Evicted */
+	sprintf(prefix, "evictor%d.example", round);
+	same_shard(waited_name, prefix, other);
+	if(cache_acquire(&c, other, strlen(other), 0, &status, buf,
+			 sizeof(buf), &len) != CACHE_MISS || c.evicted != 1){
+	    fprintf(stderr, "error: finished entry was not evicted\n");
+	    errors++;
+	}
+	cache_cleanup(&c);
+    }
+    if(waiter_errors){
+	fprintf(stderr, "error: %d waiters read a wrong result\n",
+		waiter_errors);
+	errors++;
+    }
+
+    /* Test that a hit reports the length it copied */
+    if(cache_init(&c) == CACHE_FAILURE){
+	fprintf(stderr, "error: cache_init failed!\n");
+	return 1;
+    }
+    put(&c, "big.example", TEST_BIG_RESULT);
+    put(&c, "small.example", TEST_SMALL_RESULT);
+    if(cache_acquire(&c, "big.example", 11, 1, &status, buf,
+		     TEST_SMALL_RESULT, &len) != CACHE_HIT ||
+       len != TEST_SMALL_RESULT){
+	fprintf(stderr, "error: hit reported %zu bytes for a %d byte "
+		"buffer\n", len, TEST_SMALL_RESULT);
+	errors++;
+    }
+
+    /* Test that snapshot records too big for the caller are skipped */
+    strcpy(path, TEST_SNAPSHOT);
+    if((fd = mkstemp(path)) < 0){
+	perror("error: mkstemp");
+	return 1;
+    }
+    close(fd);
+    if(cache_save(&c, path, 0, 0, 0) == CACHE_FAILURE){
+	fprintf(stderr, "error: cache_save failed!\n");
+	errors++;
+    }
+    cache_cleanup(&c);
+    if(warm(path, TEST_BIG_RESULT, "big.example", TEST_BIG_RESULT)
+       != TEST_BIG_RESULT ||
+       warm(path, TEST_BIG_RESULT, "small.example", TEST_BIG_RESULT)
+       != TEST_SMALL_RESULT){
+	fprintf(stderr, "error: snapshot did not warm the cache\n");
+	errors++;
+    }
+    if(warm(path, TEST_BIG_RESULT - 1, "big.example", TEST_BIG_RESULT)
+       != -1){
+	fprintf(stderr, "error: record over the load bound was used\n");
+	errors++;
+    }
+    if(warm(path, TEST_BIG_RESULT, "big.example", TEST_SMALL_RESULT)
+       != -1){
+	fprintf(stderr, "error: record over the buffer was used\n");
+	errors++;
+    }
+
+    /* Test that a record running past the end of the file is skipped */
+    if(set_result_len(path, "big.example", 1U << 30)){
+	fprintf(stderr, "error: record to corrupt not found\n");
+	errors++;
+    }
+    if(warm(path, 1U << 31, "big.example", TEST_BIG_RESULT) != -1 ||
+       warm(path, 1U << 31, "small.example", TEST_BIG_RESULT)
+       != TEST_SMALL_RESULT){
+	fprintf(stderr, "error: truncated record was used\n");
+	errors++;
+    }
+
+    /* Test that the record of a snapshot cut short is skipped
+     * Records are padded to 8 bytes, so cut 8 to reach its result */
+    if(cache_init(&c) == CACHE_FAILURE){
+	fprintf(stderr, "error: cache_init failed!\n");
+	return 1;
+    }
+    put(&c, "small.example", TEST_SMALL_RESULT);
+    if(cache_save(&c, path, 0, 0, 0) == CACHE_FAILURE ||
+       stat(path, &st) || truncate(path, st.st_size - 8) ||
+       warm(path, TEST_BIG_RESULT, "small.example", TEST_BIG_RESULT)
+       != -1){
+	fprintf(stderr, "error: record cut short was used\n");
+	errors++;
+    }
+    cache_cleanup(&c);
+    unlink(path);
+
+    if(errors){
+	fprintf(stderr, "cacheTest: %d errors\n", errors);
+    }
+
+    return errors ? 1 : 0;
+}
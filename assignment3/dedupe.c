@@ -0,0 +1,129 @@
+/*
+ * File: dedupe.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a sharded set of
+ *      hostnames. Tables grow at a load factor of one, so a lookup
+ *      walks a chain of about one entry under the shard lock.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dedupe.h"
+#include "cache.h"
+
+static dedupe_shard* dedupe_shard_for(dedupe* d, unsigned long hash){
+    /* high bits pick the shard, low bits the bucket, as in cache.c */
+    return &d->shards[(hash >> 48) % DEDUPE_SHARDS];
+}
+
+/* Must hold shard lock, doubles the bucket array */
+static void dedupe_grow(dedupe_shard* s){
+    size_t newMask = (s->mask << 1) | 1;
+    dedupe_entry** buckets = calloc(newMask + 1, sizeof(dedupe_entry*));
+    dedupe_entry* e;
+    dedupe_entry* next;
+    size_t i;
+
+    if(!buckets){
+	/* keep the longer chains */
+	return;
+    }
+
+    for(i=0; i<=s->mask; i++){
+	for(e = s->buckets[i]; e != NULL; e = next){
+	    next = e->next;
+	    e->next = buckets[e->hash & newMask];
+	    buckets[e->hash & newMask] = e;
+	}
+    }
+
+    free(s->buckets);
+    s->buckets = buckets;
+    s->mask = newMask;
+}
+
+int dedupe_init(dedupe* d){
+    dedupe_shard* s;
+    int i;
+
+    memset(d, 0, sizeof(dedupe));
+    for(i=0; i<DEDUPE_SHARDS; i++){
+	s = &d->shards[i];
+	s->buckets = calloc(DEDUPE_INITIAL_BUCKETS, sizeof(dedupe_entry*));
+	if(!s->buckets){
+	    perror("Error on dedupe Malloc");
+	    return DEDUPE_FAILURE;
+	}
+	s->mask = DEDUPE_INITIAL_BUCKETS - 1;
+	if(pthread_mutex_init(&s->lock, NULL)){
+	    fprintf(stderr, "Error on dedupe mutex setup\n");
+	    return DEDUPE_FAILURE;
+	}
+    }
+
+    return DEDUPE_SUCCESS;
+}
+
+int dedupe_add(dedupe* d, const char* name, size_t len){
+    unsigned long hash = cache_hash(name, len);
+    dedupe_shard* s = dedupe_shard_for(d, hash);
+    dedupe_entry* e;
+
+    __atomic_add_fetch(&d->names, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&s->lock);
+
+    for(e = s->buckets[hash & s->mask]; e != NULL; e = e->next){
+	if(e->hash == hash && e->len == len &&
+	   memcmp(e->name, name, len) == 0){
+	    pthread_mutex_unlock(&s->lock);
+	    __atomic_add_fetch(&d->repeats, 1, __ATOMIC_RELAXED);
+	    return 0;
+	}
+    }
+
+    e = malloc(sizeof(dedupe_entry) + len);
+    if(!e){
+	pthread_mutex_unlock(&s->lock);
+	return DEDUPE_FAILURE;
+    }
+    e->hash = hash;
+    e->len = len;
+    memcpy(e->name, name, len);
+    e->next = s->buckets[hash & s->mask];
+    s->buckets[hash & s->mask] = e;
+    if(++s->count > s->mask){
+	dedupe_grow(s);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return 1;
+}
+
+void dedupe_report(dedupe* d, FILE* fp){
+    fprintf(fp, "Dedupe: %lu names, %lu repeats dropped\n",
+	    d->names, d->repeats);
+}
+
+void dedupe_cleanup(dedupe* d){
+    dedupe_shard* s;
+    dedupe_entry* e;
+    dedupe_entry* next;
+    size_t b;
+    int i;
+
+    for(i=0; i<DEDUPE_SHARDS; i++){
+	s = &d->shards[i];
+	for(b=0; b<=s->mask; b++){
+	    for(e = s->buckets[b]; e != NULL; e = next){
+		next = e->next;
+		free(e);
+	    }
+	}
+	free(s->buckets);
+	pthread_mutex_destroy(&s->lock);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * File: dedupe.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a sharded, thread safe set of
+ *      hostnames used to drop repeats before they are queued. A name
+ *      hashes to one shard, whose lock guards its chained hash table.
+ *
+ */
+
+#ifndef DEDUPE_H
+#define DEDUPE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define DEDUPE_FAILURE -1
+#define DEDUPE_SUCCESS 0
+
+#define DEDUPE_SHARDS 64
+#define DEDUPE_INITIAL_BUCKETS 1024
+
+typedef struct dedupe_entry_s{
+    struct dedupe_entry_s* next;
+    unsigned long hash;
+    size_t len;
+    char name[];
+} dedupe_entry;
+
+typedef struct dedupe_shard_s{
+    pthread_mutex_t lock;
+    dedupe_entry** buckets;
+    size_t mask;
+    size_t count;
+} dedupe_shard;
+
+typedef struct dedupe_s{
+    dedupe_shard shards[DEDUPE_SHARDS];
+    unsigned long names;
+    unsigned long repeats;
+} dedupe;
+
+/* Function to initilze an empty set
+ * Returns DEDUPE_SUCCESS or DEDUPE_FAILURE
+ */
+int dedupe_init(dedupe* d);
+
+/* Function to add len bytes of name to the set
+ * Returns 1 if it is new, 0 if it was already added or
+ * DEDUPE_FAILURE if it could not be stored
+ */
+int dedupe_add(dedupe* d, const char* name, size_t len);
+
+/* Function to print how many repeats were dropped */
+void dedupe_report(dedupe* d, FILE* fp);
+
+/* Function to free set memory */
+void dedupe_cleanup(dedupe* d);
+
+#endif
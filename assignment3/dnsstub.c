@@ -0,0 +1,204 @@
+/*
+ * File: dnsstub.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains a tiny DNS server on loopback for tests.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "dnsstub.h"
+
+#define DNSSTUB_PACKET_SIZE 512
+#define DNSSTUB_POLL_MS 20
+#define DNSSTUB_RCVBUF (1 << 20)
+
+typedef struct dnsstub_msg_s{
+    struct sockaddr_storage from;
+    socklen_t fromLen;
+    int len;
+    unsigned char data[DNSSTUB_PACKET_SIZE];
+} dnsstub_msg;
+
+static unsigned int dnsstub_hash(const char* name){
+    unsigned int h = 2166136261U;
+
+    while(*name){
+	h = (h ^ (unsigned char)*name++) * 16777619U;
+    }
+    return h;
+}
+
+void dnsstub_address(const char* name, int family, unsigned char* addr){
+    unsigned int h = dnsstub_hash(name);
+
+    if(family == AF_INET){
+	addr[0] = 10;
+	addr[1] = (h >> 16) & 0xFF;
+	addr[2] = (h >> 8) & 0xFF;
+	addr[3] = h & 0xFF;
+    }
+    else{
+	memset(addr, 0, 16);
+	addr[0] = 0xfd;
+	addr[13] = (h >> 16) & 0xFF;
+	addr[14] = (h >> 8) & 0xFF;
+	addr[15] = h & 0xFF;
+    }
+}
+
+int dnsstub_answer(unsigned char* p, int n){
+    char name[256];
+    size_t len = 0;
+    int off = 12;
+    int qtype;
+    int rdlen;
+
+    if(n < 12 || (p[2] & 0x80)){
+	return 0;
+    }
+    while(off < n && p[off] != 0){
+	if(len + p[off] + 1 >= sizeof(name) || off + 1 + p[off] > n){
+	    return 0;
+	}
+	if(len > 0){
+	    name[len++] = '.';
+	}
+	memcpy(name + len, p + off + 1, p[off]);
+	len += p[off];
+	off += p[off] + 1;
+    }
+    name[len] = '\0';
+    if(off + 5 > n){
+	return 0;
+    }
+    qtype = (p[off + 1] << 8) | p[off + 2];
+    off += 5;
+
+    if(strncmp(name, "drop", 4) == 0){
+	return 0;
+    }
+
+    /* response, recursion available, no answers yet */
+    p[2] |= 0x80;
+    p[3] = 0x80;
+    p[6] = p[7] = p[8] = p[9] = p[10] = p[11] = 0;
+    if(strncmp(name, "nx", 2) == 0){
+	p[3] |= 3;
+	return off;
+    }
+
+    rdlen = qtype == 28 ? 16 : 4;
+    if(qtype != 1 && qtype != 28){
+	return off;
+    }
+    p[7] = 1;
+    p[off++] = 0xC0;		/* pointer to the question name */
+    p[off++] = 12;
+    p[off++] = 0;
+    p[off++] = qtype;
+    p[off++] = 0;
+    p[off++] = 1;
+    p[off++] = 0;		/* ttl 300 */
+    p[off++] = 0;
+    p[off++] = 1;
+    p[off++] = 44;
+    p[off++] = 0;
+    p[off++] = rdlen;
+    dnsstub_address(name, rdlen == 4 ? AF_INET : AF_INET6, p + off);
+
+    return off + rdlen;
+}
+
+static void* dnsstub_run(void* arg){
+    dnsstub* stub = arg;
+    dnsstub_msg* burst = malloc(sizeof(dnsstub_msg) * DNSSTUB_BURST);
+    struct pollfd pfd;
+    int count;
+    int len;
+    int i;
+
+    pfd.fd = stub->sock;
+    pfd.events = POLLIN;
+
+    while(burst && !__atomic_load_n(&stub->stop, __ATOMIC_ACQUIRE)){
+	if(poll(&pfd, 1, DNSSTUB_POLL_MS) <= 0){
+	    continue;
+	}
+
+	/* gather a burst, then answer newest first */
+	for(count=0; count<DNSSTUB_BURST; count++){
+	    burst[count].fromLen = sizeof(burst[count].from);
+	    burst[count].len = recvfrom(stub->sock, burst[count].data,
+					DNSSTUB_PACKET_SIZE - 32,
+					MSG_DONTWAIT,
+					(struct sockaddr*)&burst[count].from,
+					&burst[count].fromLen);
+	    if(burst[count].len <= 0){
+		break;
+	    }
+	}
+	stub->queries += count;
+	for(i=count-1; i>=0; i--){
+	    if((len = dnsstub_answer(burst[i].data, burst[i].len)) > 0){
+		sendto(stub->sock, burst[i].data, len, 0,
+		       (struct sockaddr*)&burst[i].from, burst[i].fromLen);
+	    }
+	}
+    }
+
+    free(burst);
+    return NULL;
+}
+
+int dnsstub_start(dnsstub* stub){
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int rcvbuf = DNSSTUB_RCVBUF;
+
+    stub->stop = 0;
+    stub->queries = 0;
+    stub->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(stub->sock < 0){
+	perror("Error creating stub socket");
+	return DNSSTUB_FAILURE;
+    }
+
+    /* room for a full burst from a busy client */
+    setsockopt(stub->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if(bind(stub->sock, (struct sockaddr*)&addr, sizeof(addr)) ||
+       getsockname(stub->sock, (struct sockaddr*)&addr, &len)){
+	perror("Error binding stub socket");
+	close(stub->sock);
+	return DNSSTUB_FAILURE;
+    }
+    stub->port = ntohs(addr.sin_port);
+
+    if(pthread_create(&stub->thread, NULL, dnsstub_run, stub)){
+	fprintf(stderr, "Error creating stub thread\n");
+	close(stub->sock);
+	return DNSSTUB_FAILURE;
+    }
+
+    return DNSSTUB_SUCCESS;
+}
+
+void dnsstub_stop(dnsstub* stub){
+    __atomic_store_n(&stub->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(stub->thread, NULL);
+    close(stub->sock);
+}
@@ -0,0 +1,53 @@
+/*
+ * File: dnsstub.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a tiny DNS server on loopback used to
+ *      test the asynchronous client without a network. Answers are made
+ *      up from the query name:
+ *          nx*    answers NXDOMAIN
+ *          drop*  gets no answer
+ *          other  one A record 10.x.y.z and one AAAA record fd00::x:y:z
+ *      Each burst of queries is answered in reverse order.
+ *
+ */
+
+#ifndef DNSSTUB_H
+#define DNSSTUB_H
+
+#include <pthread.h>
+
+#define DNSSTUB_FAILURE -1
+#define DNSSTUB_SUCCESS 0
+
+#define DNSSTUB_BURST 64
+
+typedef struct dnsstub_s{
+    int sock;
+    int port;
+    int stop;
+    unsigned long queries;
+    pthread_t thread;
+} dnsstub;
+
+/* Function to start the server on 127.0.0.1 and an ephemeral port
+ * Returns DNSSTUB_SUCCESS or DNSSTUB_FAILURE
+ */
+int dnsstub_start(dnsstub* stub);
+
+/* Function to fill in the address the stub answers for name
+ * addr must hold 4 bytes for AF_INET and 16 for AF_INET6
+ */
+void dnsstub_address(const char* name, int family, unsigned char* addr);
+
+/* Function to turn the n byte query in p into its answer in place
+ * p must have 32 bytes of room past the query
+ * Returns the answer length, or 0 if the query gets none
+ */
+int dnsstub_answer(unsigned char* p, int n);
+
+/* Function to stop the server and join its thread */
+void dnsstub_stop(dnsstub* stub);
+
+#endif
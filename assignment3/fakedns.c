@@ -0,0 +1,260 @@
+/*
+ * File: fakedns.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of the fake resolver backend.
+ *      Every lookup has the same delay, so asynchronous lookups finish
+ *      in the order they were submitted and wait in a ring.
+ *
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "fakedns.h"
+
+static int fakedns_open(util_backend* b, const char* arg);
+static int fakedns_lookup(util_backend* b, const char* hostname,
+			  util_addr* addrs, int* num_addrs, int maxAddrs);
+static int fakedns_async_open(util_async* a);
+static int fakedns_submit(util_async* a, const char* name, size_t len,
+			  void* user);
+static int fakedns_poll(util_async* a, util_answer* answers, int max,
+			int timeoutMs);
+static int fakedns_inflight(util_async* a);
+static void fakedns_async_close(util_async* a);
+static void fakedns_destroy(util_backend* b);
+
+const util_backend_ops fake_backend_ops = {
+    "fake", fakedns_open, fakedns_lookup, fakedns_async_open,
+    fakedns_submit, fakedns_poll, fakedns_inflight, fakedns_async_close,
+    fakedns_destroy
+};
+
+static const char* fakedns_log = NULL;
+static unsigned int* fakedns_samples = NULL;
+static unsigned long fakedns_count = 0;
+
+static long long fakedns_now_us(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fakedns_sleep_us(long long us){
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while(nanosleep(&ts, &ts) && errno == EINTR){
+    }
+}
+
+static void fakedns_record(long long us){
+    unsigned long slot;
+
+    if(fakedns_samples){
+	slot = __atomic_fetch_add(&fakedns_count, 1, __ATOMIC_RELAXED);
+	if(slot < FAKEDNS_MAX_SAMPLES){
+	    fakedns_samples[slot] = us;
+	}
+    }
+}
+
+__attribute__((destructor))
+static void fakedns_write_log(void){
+    FILE* fp;
+    unsigned long n = fakedns_count;
+    unsigned long i;
+
+    if(!fakedns_samples){
+	return;
+    }
+    if(n > FAKEDNS_MAX_SAMPLES){
+	n = FAKEDNS_MAX_SAMPLES;
+    }
+
+    fp = fopen(fakedns_log, "w");
+    if(!fp){
+	perror("Error Opening Fake DNS Log");
+	return;
+    }
+    for(i=0; i<n; i++){
+	fprintf(fp, "%u\n", fakedns_samples[i]);
+    }
+    fclose(fp);
+    free(fakedns_samples);
+    fakedns_samples = NULL;
+}
+
+/* Make up the answer for a name, with the addresses profile asks for
+ * Returns the status and fills answer's addresses
+ */
+static int fakedns_answer(fakedns* f, const util_profile* profile,
+			  const char* name, size_t len, util_answer* answer){
+    /* 32 bit FNV-1a */
+    unsigned int h = 2166136261U;
+    util_addr* addr;
+    size_t i;
+
+    for(i=0; i<len; i++){
+	h ^= (unsigned char)name[i];
+	h *= 16777619U;
+    }
+
+    answer->num_addrs = 0;
+    if(len >= 2 && strncmp(name, "nx", 2) == 0){
+	return UTIL_NOTFOUND;
+    }
+    if((int)(h % 100) < f->failPercent){
+	return (h / 100) % 2 ? UTIL_NOTFOUND : UTIL_TIMEOUT;
+    }
+
+    if(util_profile_wants(profile, AF_INET)){
+	addr = &answer->addrs[answer->num_addrs++];
+	addr->family = AF_INET;
+	addr->addr[0] = 10;
+	addr->addr[1] = (h >> 16) & 0xFF;
+	addr->addr[2] = (h >> 8) & 0xFF;
+	addr->addr[3] = h & 0xFF;
+    }
+
+    if(util_profile_wants(profile, AF_INET6)){
+	addr = &answer->addrs[answer->num_addrs++];
+	addr->family = AF_INET6;
+	memset(addr->addr, 0, sizeof(addr->addr));
+	addr->addr[0] = 0xfd;
+	addr->addr[13] = (h >> 16) & 0xFF;
+	addr->addr[14] = (h >> 8) & 0xFF;
+	addr->addr[15] = h & 0xFF;
+    }
+
+    return UTIL_SUCCESS;
+}
+
+/* Delay for a blocking lookup, slow* names make a tail
+ * Async answers keep one delay so they stay in submit order
+ */
+static long fakedns_latency_us(fakedns* f, const char* name, size_t len){
+    if(len >= 4 && strncmp(name, "slow", 4) == 0){
+	return f->latencyUs * FAKEDNS_SLOW_FACTOR;
+    }
+    return f->latencyUs;
+}
+
+static int fakedns_open(util_backend* b, const char* arg){
+    fakedns* f = malloc(sizeof(fakedns));
+
+    if(!f){
+	perror("Error on fake Malloc");
+	return UTIL_FAILURE;
+    }
+    f->latencyUs = FAKEDNS_DEFAULT_LATENCY_US;
+    f->failPercent = 0;
+    if(arg && sscanf(arg, "%ld:%d", &f->latencyUs, &f->failPercent) < 1){
+	fprintf(stderr, "fake backend takes fake[:latencyUs[:failPercent]]\n");
+	free(f);
+	return UTIL_FAILURE;
+    }
+    b->state = f;
+
+    fakedns_log = getenv("FAKEDNS_LOG");
+    if(fakedns_log && !fakedns_samples){
+	fakedns_samples = malloc(sizeof(unsigned int) * FAKEDNS_MAX_SAMPLES);
+    }
+
+    return UTIL_SUCCESS;
+}
+
+static int fakedns_lookup(util_backend* b, const char* hostname,
+			  util_addr* addrs, int* num_addrs, int maxAddrs){
+    fakedns* f = b->state;
+    util_answer answer;
+    long long start = fakedns_now_us();
+    int status;
+    int i;
+
+    status = fakedns_answer(f, &b->profile, hostname, strlen(hostname),
+			    &answer);
+    fakedns_sleep_us(fakedns_latency_us(f, hostname, strlen(hostname)));
+    fakedns_record(fakedns_now_us() - start);
+
+    for(i=0; i<answer.num_addrs && i<maxAddrs; i++){
+	addrs[i] = answer.addrs[i];
+    }
+    *num_addrs = i;
+
+    return status;
+}
+
+static int fakedns_async_open(util_async* a){
+    a->state = malloc(sizeof(fakedns_query) * a->maxInflight);
+    if(!a->state){
+	perror("Error on fake Malloc");
+	return UTIL_FAILURE;
+    }
+    return UTIL_SUCCESS;
+}
+
+static int fakedns_submit(util_async* a, const char* name, size_t len,
+			  void* user){
+    fakedns* f = a->backend->state;
+    fakedns_query* q;
+
+    if(a->count == a->maxInflight){
+	return UTIL_FAILURE;
+    }
+
+    q = &((fakedns_query*)a->state)[(a->head + a->count) % a->maxInflight];
+    q->startUs = fakedns_now_us();
+    q->dueUs = q->startUs + f->latencyUs;
+    q->answer.user = user;
+    q->answer.status = fakedns_answer(f, &a->backend->profile, name, len,
+				     &q->answer);
+    a->count++;
+
+    return UTIL_SUCCESS;
+}
+
+static int fakedns_poll(util_async* a, util_answer* answers, int max,
+			int timeoutMs){
+    fakedns_query* queries = a->state;
+    long long now = fakedns_now_us();
+    long long wait = (long long)timeoutMs * 1000;
+    int n = 0;
+
+    /* Sleep until the oldest is due, or the timeout */
+    if(a->count > 0 && queries[a->head].dueUs - now < wait){
+	wait = queries[a->head].dueUs - now;
+    }
+    if(wait > 0){
+	fakedns_sleep_us(wait);
+	now = fakedns_now_us();
+    }
+
+    while(n < max && a->count > 0 && queries[a->head].dueUs <= now){
+	answers[n] = queries[a->head].answer;
+	answers[n].elapsedMs = (now - queries[a->head].startUs) / 1000;
+	fakedns_record(now - queries[a->head].startUs);
+	a->head = (a->head + 1) % a->maxInflight;
+	a->count--;
+	n++;
+    }
+
+    return n;
+}
+
+static int fakedns_inflight(util_async* a){
+    return a->count;
+}
+
+static void fakedns_async_close(util_async* a){
+    free(a->state);
+}
+
+static void fakedns_destroy(util_backend* b){
+    free(b->state);
+    b->state = NULL;
+}
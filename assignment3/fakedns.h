@@ -0,0 +1,45 @@
+/*
+ * File: fakedns.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for an offline resolver backend that makes
+ *      up deterministic answers after a fixed delay, for profiling the
+ *      threading pipeline and benchmarking without a network:
+ *          nx*    UTIL_NOTFOUND
+ *          slow*  as below, blocking lookups wait FAKEDNS_SLOW_FACTOR
+ *                 times the delay
+ *          other  one A record 10.x.y.z and one AAAA record fd00::x:y:z,
+ *                 or for failPercent of names chosen by hash a
+ *                 UTIL_NOTFOUND or UTIL_TIMEOUT
+ *      Asynchronous lookups all wait out the delay concurrently.
+ *      With FAKEDNS_LOG set in the environment each lookup's time in
+ *      us is written to that file at exit, one per line.
+ *
+ */
+
+#ifndef FAKEDNS_H
+#define FAKEDNS_H
+
+#include "util.h"
+
+#define FAKEDNS_DEFAULT_LATENCY_US 1000
+#define FAKEDNS_MAX_SAMPLES (1 << 22)
+#define FAKEDNS_SLOW_FACTOR 100
+
+typedef struct fakedns_s{
+    long latencyUs;
+    int failPercent;
+} fakedns;
+
+/* One asynchronous lookup waiting out its delay */
+typedef struct fakedns_query_s{
+    long long startUs;
+    long long dueUs;
+    util_answer answer;
+} fakedns_query;
+
+/* Backend "fake[:latencyUs[:failPercent]]" */
+extern const util_backend_ops fake_backend_ops;
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * File: hedge.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of deadline bounded, hedged
+ *      blocking lookups. Helpers take jobs from one queue under one
+ *      lock; a call is freed by whichever of its caller and jobs lets
+ *      go of it last, so an abandoned lookup can finish safely. A
+ *      helper stuck in one is replaced by a spare, and whichever helper
+ *      frees up while there are more than enough exits.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "hedge.h"
+#include "stats.h"
+
+static unsigned long long hedge_now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int hedge_compare(const void* a, const void* b){
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Must hold lock, drops one reference to call */
+static void hedge_release(hedge* h, hedge_call* call){
+    if(--call->refs == 0){
+	call->next = h->free;
+	h->free = call;
+    }
+}
+
+/* Must hold lock, queues a run of call on b
+ * Returns HEDGE_SUCCESS or HEDGE_FAILURE
+ */
+static int hedge_push(hedge* h, hedge_call* call, util_backend* b,
+		      int isHedge){
+    hedge_job* jobs;
+    int i;
+
+    if(h->count == h->cap){
+	jobs = malloc(sizeof(hedge_job) * h->cap * 2);
+	if(!jobs){
+	    return HEDGE_FAILURE;
+	}
+	for(i=0; i<h->count; i++){
+	    jobs[i] = h->jobs[(h->head + i) % h->cap];
+	}
+	free(h->jobs);
+	h->jobs = jobs;
+	h->head = 0;
+	h->cap *= 2;
+    }
+
+    h->jobs[(h->head + h->count) % h->cap].call = call;
+    h->jobs[(h->head + h->count) % h->cap].backend = b;
+    h->jobs[(h->head + h->count) % h->cap].hedge = isHedge;
+    h->count++;
+    call->refs++;
+    pthread_cond_signal(&h->work);
+
+    return HEDGE_SUCCESS;
+}
+
+/* Must hold lock, adds an answer's latency and every HEDGE_REFRESH
+ * answers recomputes the hedge delay outside the lock
+ */
+static void hedge_sample(hedge* h, unsigned long long ns){
+    unsigned long long sorted[HEDGE_WINDOW];
+    unsigned long n;
+
+    h->window[h->samples++ % HEDGE_WINDOW] = ns;
+    if(h->samples < HEDGE_MIN_SAMPLES ||
+       (h->samples > HEDGE_MIN_SAMPLES && h->samples % HEDGE_REFRESH)){
+	return;
+    }
+
+    n = h->samples < HEDGE_WINDOW ? h->samples : HEDGE_WINDOW;
+    memcpy(sorted, h->window, sizeof(sorted[0]) * n);
+    pthread_mutex_unlock(&h->lock);
+    qsort(sorted, n, sizeof(sorted[0]), hedge_compare);
+    pthread_mutex_lock(&h->lock);
+    h->hedgeNs = sorted[(n * HEDGE_PERMILLE) / 1000];
+}
+
+static void* hedge_helper(void* arg);
+
+/* Must hold lock, starts one detached helper
+ * Detached, a helper stuck in a lookup must not hold up exit
+ * Returns HEDGE_SUCCESS or HEDGE_FAILURE
+ */
+static int hedge_spawn(hedge* h){
+    pthread_t thread;
+
+    if(pthread_create(&thread, NULL, hedge_helper, h)){
+	fprintf(stderr, "Error creating hedge helper\n");
+	return HEDGE_FAILURE;
+    }
+    pthread_detach(thread);
+    h->alive++;
+
+    return HEDGE_SUCCESS;
+}
+
+/* Must hold lock, keeps helpers free for live calls by starting
+ * spares while some are stuck, within HEDGE_MAX_SPARE
+ */
+static void hedge_replace(hedge* h){
+    while(!h->closed && h->alive - h->stuck < h->helpers &&
+	  h->alive < h->helpers + HEDGE_MAX_SPARE &&
+	  hedge_spawn(h) == HEDGE_SUCCESS){
+	h->spares++;
+    }
+}
+
+static void* hedge_helper(void* arg){
+    hedge* h = arg;
+    util_addr addrs[UTIL_MAX_ADDRS];
+    unsigned long long start;
+    hedge_job job;
+    hedge_call* call;
+    int num_addrs;
+    int status;
+
+    pthread_mutex_lock(&h->lock);
+    for(;;){
+	while(h->count == 0 && !h->closed){
+	    pthread_cond_wait(&h->work, &h->lock);
+	}
+	if(h->closed){
+	    break;
+	}
+	job = h->jobs[h->head];
+	h->head = (h->head + 1) % h->cap;
+	h->count--;
+	call = job.call;
+
+	/* Answered Or Abandoned While Queued */
+	if(call->done || !call->waiting){
+	    hedge_release(h, call);
+	    continue;
+	}
+
+	/* Lookup Outside The Lock */
+	h->busy++;
+	call->running++;
+	pthread_mutex_unlock(&h->lock);
+	num_addrs = 0;
+	start = hedge_now_ns();
+	status = job.backend->ops->lookup(job.backend, call->name, addrs,
+					  &num_addrs, UTIL_MAX_ADDRS);
+	pthread_mutex_lock(&h->lock);
+	h->busy--;
+	call->running--;
+
+	/* Stuck Since Its Caller Left, A Spare May Have Taken Our Place */
+	if(!call->waiting){
+	    h->stuck--;
+	}
+
+	if(!call->done){
+	    call->done = 1;
+	    call->winner = job.hedge;
+	    call->status = status;
+	    call->num_addrs = status == UTIL_SUCCESS ? num_addrs : 0;
+	    memcpy(call->addrs, addrs, sizeof(util_addr) * call->num_addrs);
+	    pthread_cond_signal(&call->answered);
+	}
+	hedge_release(h, call);
+	if(!job.hedge){
+	    hedge_sample(h, hedge_now_ns() - start);
+	}
+	if(h->alive - h->stuck > h->helpers){
+	    break;
+	}
+    }
+    h->alive--;
+    pthread_cond_broadcast(&h->idle);
+    pthread_mutex_unlock(&h->lock);
+
+    return NULL;
+}
+
+int hedge_init(hedge* h, util_backend* primary, util_backend* secondary,
+	       long deadlineMs, int helpers){
+    int i;
+
+    memset(h, 0, sizeof(hedge));
+    h->primary = primary;
+    h->secondary = secondary;
+    h->deadlineMs = deadlineMs;
+    h->cap = HEDGE_INITIAL_JOBS;
+    h->jobs = malloc(sizeof(hedge_job) * h->cap);
+    if(!h->jobs){
+	perror("Error on hedge Malloc");
+	return HEDGE_FAILURE;
+    }
+    if(pthread_mutex_init(&h->lock, NULL) ||
+       pthread_cond_init(&h->work, NULL) ||
+       pthread_cond_init(&h->idle, NULL)){
+	fprintf(stderr, "Error on hedge mutex setup\n");
+	free(h->jobs);
+	return HEDGE_FAILURE;
+    }
+
+    pthread_mutex_lock(&h->lock);
+    for(i=0; i<helpers && hedge_spawn(h) == HEDGE_SUCCESS; i++){
+    }
+    h->helpers = i;
+    pthread_mutex_unlock(&h->lock);
+    if(i == 0){
+	hedge_cleanup(h);
+	return HEDGE_FAILURE;
+    }
+
+    return HEDGE_SUCCESS;
+}
+
+/* Must hold lock, takes a call from the free list or makes one
+ * Returns the call or NULL
+ */
+static hedge_call* hedge_call_get(hedge* h){
+    pthread_condattr_t attr;
+    hedge_call* call = h->free;
+
+    if(call){
+	h->free = call->next;
+	return call;
+    }
+    call = malloc(sizeof(hedge_call));
+    if(!call){
+	return NULL;
+    }
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if(pthread_cond_init(&call->answered, &attr)){
+	free(call);
+	call = NULL;
+    }
+    pthread_condattr_destroy(&attr);
+
+    return call;
+}
+
+int hedge_lookup(hedge* h, const char* name, size_t len, util_addr* addrs,
+		 int* num_addrs, int maxAddrs){
+    unsigned long long never = ~0ULL;
+    unsigned long long start;
+    unsigned long long now;
+    unsigned long long hedgeAt;
+    unsigned long long sentAt = 0;
+    unsigned long long deadline;
+    unsigned long long wake;
+    struct timespec ts;
+    hedge_call* call;
+    int status;
+    int i;
+
+    *num_addrs = 0;
+    if(len > UTIL_MAX_NAME){
+	return UTIL_FAILURE;
+    }
+
+    pthread_mutex_lock(&h->lock);
+    call = hedge_call_get(h);
+    if(!call){
+	pthread_mutex_unlock(&h->lock);
+	return UTIL_FAILURE;
+    }
+    memcpy(call->name, name, len);
+    call->name[len] = '\0';
+    call->refs = 1;
+    call->running = 0;
+    call->waiting = 1;
+    call->done = 0;
+    if(hedge_push(h, call, h->primary, 0) == HEDGE_FAILURE){
+	hedge_release(h, call);
+	pthread_mutex_unlock(&h->lock);
+	return UTIL_FAILURE;
+    }
+    h->lookups++;
+
+    /* Hedge Only Once The Percentile Means Something */
+    start = hedge_now_ns();
+    hedgeAt = h->secondary && h->hedgeNs > 0 ? start + h->hedgeNs : never;
+    deadline = h->deadlineMs > 0 ?
+	start + (unsigned long long)h->deadlineMs * 1000000ULL : never;
+
+    while(!call->done){
+	wake = hedgeAt < deadline ? hedgeAt : deadline;
+	if(wake == never){
+	    pthread_cond_wait(&call->answered, &h->lock);
+	    continue;
+	}
+	ts.tv_sec = wake / 1000000000ULL;
+	ts.tv_nsec = wake % 1000000000ULL;
+	if(pthread_cond_timedwait(&call->answered, &h->lock, &ts)
+	   != ETIMEDOUT){
+	    continue;
+	}
+
+	now = hedge_now_ns();
+	if(now >= hedgeAt){
+	    if(hedge_push(h, call, h->secondary, 1) == HEDGE_SUCCESS){
+		h->hedged++;
+		sentAt = now;
+	    }
+	    hedgeAt = never;
+	}
+	else if(now >= deadline){
+	    break;
+	}
+    }
+
+    if(call->done){
+	status = call->status;
+	for(i=0; i<call->num_addrs && i<maxAddrs; i++){
+	    addrs[i] = call->addrs[i];
+	}
+	*num_addrs = i;
+	if(call->winner){
+	    h->won++;
+	}
+    }
+    else{
+	status = UTIL_TIMEOUT;
+	h->expired++;
+    }
+    i = call->done && call->winner;
+    call->waiting = 0;
+
+    /* Helpers Still On It Are Stuck Until The Backend Returns */
+    if(call->running > 0){
+	h->stuck += call->running;
+	hedge_replace(h);
+    }
+    hedge_release(h, call);
+    pthread_mutex_unlock(&h->lock);
+
+    /* A Hedge's Wait From Sending To Answer, Contended If It Won */
+    now = hedge_now_ns();
+    if(sentAt){
+	stats_record(STATS_HEDGE, now - sentAt, i);
+    }
+    if(status == UTIL_TIMEOUT && now >= deadline){
+	stats_record(STATS_DEADLINE, now - start, 1);
+    }
+
+    return status;
+}
+
+void hedge_report(hedge* h, FILE* fp){
+    if(h->secondary){
+	fprintf(fp, "Hedge: %lu lookups, %lu hedged after the p95 of "
+		"%.1f ms, %lu won by the hedge\n", h->lookups, h->hedged,
+		h->hedgeNs / 1000000.0, h->won);
+    }
+    if(h->deadlineMs > 0){
+	fprintf(fp, "Hedge: %lu of %lu lookups past the %ld ms deadline\n",
+		h->expired, h->lookups, h->deadlineMs);
+    }
+    fprintf(fp, "Hedge: %d helpers, %lu spares started for abandoned "
+	    "lookups\n", h->helpers, h->spares);
+}
+
+int hedge_cleanup(hedge* h){
+    hedge_call* call;
+
+    /* Idle Helpers Exit, Busy Ones After Their Lookup */
+    pthread_mutex_lock(&h->lock);
+    h->closed = 1;
+    pthread_cond_broadcast(&h->work);
+    while(h->alive > h->busy){
+	pthread_cond_wait(&h->idle, &h->lock);
+    }
+    if(h->alive > 0){
+	pthread_mutex_unlock(&h->lock);
+	return HEDGE_FAILURE;
+    }
+
+    /* Jobs Left Queued Belong To Abandoned Calls */
+    while(h->count > 0){
+	hedge_release(h, h->jobs[h->head].call);
+	h->head = (h->head + 1) % h->cap;
+	h->count--;
+    }
+    while((call = h->free) != NULL){
+	h->free = call->next;
+	pthread_cond_destroy(&call->answered);
+	free(call);
+    }
+    free(h->jobs);
+    h->jobs = NULL;
+    pthread_mutex_unlock(&h->lock);
+    pthread_cond_destroy(&h->idle);
+    pthread_cond_destroy(&h->work);
+    pthread_mutex_destroy(&h->lock);
+
+    return HEDGE_SUCCESS;
+}
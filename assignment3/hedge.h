@@ -0,0 +1,118 @@
+/*
+ * File: hedge.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for blocking lookups with a deadline and
+ *      optional hedging. Lookups run on helper threads while the caller
+ *      waits on a condition variable, so the caller can give up at its
+ *      deadline even when getaddrinfo would not. A lookup that has not
+ *      answered by the observed p95 gets a duplicate on a second backend
+ *      and the first answer wins; the loser finishes on its helper and
+ *      is dropped. A helper left running a lookup nobody waits for is
+ *      replaced, up to a bound, so it does not hold up other names.
+ *
+ */
+
+#ifndef HEDGE_H
+#define HEDGE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "util.h"
+
+#define HEDGE_FAILURE -1
+#define HEDGE_SUCCESS 0
+
+/* Latencies kept for the percentile, and how often it is recomputed */
+#define HEDGE_WINDOW 1024
+#define HEDGE_REFRESH 64
+/* Answers seen before hedging starts */
+#define HEDGE_MIN_SAMPLES 100
+#define HEDGE_PERMILLE 950
+#define HEDGE_INITIAL_JOBS 64
+/* Most helpers started to replace ones stuck in abandoned lookups */
+#define HEDGE_MAX_SPARE 64
+
+/* One lookup, shared by its caller and the helpers running it */
+typedef struct hedge_call_s{
+    struct hedge_call_s* next;
+    pthread_cond_t answered;
+    int refs;
+    /* helpers running it now */
+    int running;
+    int waiting;
+    int done;
+    int winner;
+    int status;
+    int num_addrs;
+    util_addr addrs[UTIL_MAX_ADDRS];
+    char name[UTIL_MAX_NAME + 1];
+} hedge_call;
+
+/* One run of a call on a backend */
+typedef struct hedge_job_s{
+    hedge_call* call;
+    util_backend* backend;
+    int hedge;
+} hedge_job;
+
+typedef struct hedge_s{
+    util_backend* primary;
+    util_backend* secondary;
+    long deadlineMs;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    hedge_job* jobs;
+    int head;
+    int count;
+    int cap;
+    hedge_call* free;
+    int helpers;
+    int alive;
+    int busy;
+    /* busy helpers whose caller has gone */
+    int stuck;
+    int closed;
+    unsigned long long window[HEDGE_WINDOW];
+    unsigned long samples;
+    unsigned long long hedgeNs;
+    unsigned long lookups;
+    unsigned long hedged;
+    unsigned long won;
+    unsigned long expired;
+    unsigned long spares;
+} hedge;
+
+/* Function to start helpers threads looking up on primary
+ * While some are stuck in abandoned lookups up to HEDGE_MAX_SPARE
+ * more are started so helpers remain free for live ones
+ * secondary gets the duplicates, or is NULL for no hedging
+ * deadlineMs bounds each lookup, or is 0 for no deadline
+ * Returns HEDGE_SUCCESS or HEDGE_FAILURE
+ */
+int hedge_init(hedge* h, util_backend* primary, util_backend* secondary,
+	       long deadlineMs, int helpers);
+
+/* Function to lookup len bytes of name as util_lookup does
+ * Returns the status, UTIL_TIMEOUT if the deadline passed first
+ */
+int hedge_lookup(hedge* h, const char* name, size_t len, util_addr* addrs,
+		 int* num_addrs, int maxAddrs);
+
+/* Function to print hedges sent and won, deadlines missed and spare
+ * helpers started
+ */
+void hedge_report(hedge* h, FILE* fp);
+
+/* Function to stop the helpers and free what they no longer use
+ * Helpers still inside an abandoned lookup are left to finish it
+ * Returns HEDGE_SUCCESS, or HEDGE_FAILURE if some are, in which case
+ * their backends must stay open
+ */
+int hedge_cleanup(hedge* h);
+
+#endif
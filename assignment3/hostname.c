@@ -0,0 +1,129 @@
+/*
+ * File: hostname.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of hostname normalization.
+ *      Bytes are classified and lowercased 16 at a time with SSE2
+ *      where available and a byte at a time otherwise; labels are then
+ *      checked between dots.
+ *
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hostname.h"
+
+static int hostname_is_upper(unsigned char c){
+    return (unsigned char)(c - 'A') <= 'Z' - 'A';
+}
+
+static int hostname_is_valid(unsigned char c){
+    return (unsigned char)((c | 0x20) - 'a') <= 'z' - 'a' ||
+	(unsigned char)(c - '0') <= 9 || c == '-' || c == '_' || c == '.';
+}
+
+/* Check the bytes of name, lowercasing them into out unless it is NULL
+ * Returns 1 if every byte may be in a hostname, and sets *upper if any
+ * was uppercase
+ */
+static int hostname_scan(const char* name, size_t len, char* out,
+			 int* upper){
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i b;
+    __m128i lower;
+    __m128i alpha;
+    __m128i digit;
+    __m128i punct;
+    __m128i up;
+
+    for(; i + 16 <= len; i += 16){
+	/* Bytes >= 0x80 Are Negative, So Fall Outside Every Range */
+	b = _mm_loadu_si128((const __m128i*)(name + i));
+	lower = _mm_or_si128(b, _mm_set1_epi8(0x20));
+	alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+			      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+	digit = _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8('0' - 1)),
+			      _mm_cmplt_epi8(b, _mm_set1_epi8('9' + 1)));
+	punct = _mm_or_si128(
+	    _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('-')),
+			 _mm_cmpeq_epi8(b, _mm_set1_epi8('_'))),
+	    _mm_cmpeq_epi8(b, _mm_set1_epi8('.')));
+	if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), punct))
+	   != 0xFFFF){
+	    return 0;
+	}
+
+	up = _mm_and_si128(alpha, _mm_cmplt_epi8(b, _mm_set1_epi8('Z' + 1)));
+	if(_mm_movemask_epi8(up)){
+	    *upper = 1;
+	}
+	if(out){
+	    _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(
+		b, _mm_and_si128(up, _mm_set1_epi8(0x20))));
+	}
+    }
+#endif
+    for(; i < len; i++){
+	if(!hostname_is_valid(name[i])){
+	    return 0;
+	}
+	if(hostname_is_upper(name[i])){
+	    *upper = 1;
+	}
+	if(out){
+	    out[i] = hostname_is_upper(name[i]) ? name[i] | 0x20 : name[i];
+	}
+    }
+    return 1;
+}
+
+/* Check label lengths of a name with its trailing dot removed
+ * Returns 1 if every label is 1 to HOSTNAME_LABEL_MAX bytes
+ */
+static int hostname_labels(const char* name, size_t len){
+    const char* end = name + len;
+    const char* dot;
+
+    if(len == 0 || len > HOSTNAME_MAX || name[len - 1] == '.'){
+	return 0;
+    }
+    while(name < end){
+	dot = memchr(name, '.', end - name);
+	if(!dot){
+	    dot = end;
+	}
+	if(dot == name || dot - name > HOSTNAME_LABEL_MAX){
+	    return 0;
+	}
+	name = dot + 1;
+    }
+    return 1;
+}
+
+int hostname_is_normal(const char* name, size_t len){
+    int upper = 0;
+
+    if(len == 0 || name[len - 1] == '.'){
+	return 0;
+    }
+    return hostname_scan(name, len, NULL, &upper) && !upper &&
+	hostname_labels(name, len);
+}
+
+size_t hostname_normalize(const char* name, size_t len, char* out){
+    int upper = 0;
+
+    if(len > 0 && name[len - 1] == '.'){
+	len--;
+    }
+    if(!hostname_scan(name, len, out, &upper) || !hostname_labels(out, len)){
+	return 0;
+    }
+    return len;
+}
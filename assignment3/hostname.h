@@ -0,0 +1,33 @@
+/*
+ * File: hostname.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for hostname normalization. Names are
+ *      lowercased, lose a trailing root dot and are checked against
+ *      the usual hostname rules: letters, digits, '-' and '_' in dot
+ *      separated labels of 1 to 63 bytes, 253 bytes in all.
+ *
+ */
+
+#ifndef HOSTNAME_H
+#define HOSTNAME_H
+
+#include <stddef.h>
+
+#define HOSTNAME_MAX 253
+#define HOSTNAME_LABEL_MAX 63
+
+/* Function to check whether len bytes of name are already normalized
+ * Returns 1 if name can be used as is, 0 if it must be normalized or
+ * is invalid
+ */
+int hostname_is_normal(const char* name, size_t len);
+
+/* Function to normalize len bytes of name into out
+ * out may be name; it needs len bytes
+ * Returns the normalized length, 0 if the name is invalid
+ */
+size_t hostname_normalize(const char* name, size_t len, char* out);
+
+#endif
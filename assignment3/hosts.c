@@ -0,0 +1,223 @@
+/*
+ * File: hosts.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of the hosts file resolver
+ *      backend as a chained hash table of names.
+ *
+ */
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "hosts.h"
+
+static int hosts_open(util_backend* b, const char* arg);
+static int hosts_lookup(util_backend* b, const char* hostname,
+			util_addr* addrs, int* num_addrs, int maxAddrs);
+static void hosts_destroy(util_backend* b);
+
+const util_backend_ops hosts_backend_ops = {
+    "hosts", hosts_open, hosts_lookup, NULL, NULL, NULL, NULL, NULL,
+    hosts_destroy
+};
+
+static unsigned long hosts_hash(const char* name, size_t len){
+    /* 64 bit FNV-1a, names compare without case like DNS */
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i;
+
+    for(i=0; i<len; i++){
+	h ^= (unsigned char)tolower((unsigned char)name[i]);
+	h *= 1099511628211ULL;
+    }
+
+    return (unsigned long)(h ^ (h >> 32));
+}
+
+static hosts_entry* hosts_find(hosts_table* t, unsigned long hash,
+			       const char* name){
+    hosts_entry* e;
+
+    for(e = t->buckets[hash & t->mask]; e != NULL; e = e->next){
+	if(e->hash == hash && strcasecmp(e->name, name) == 0){
+	    return e;
+	}
+    }
+
+    return NULL;
+}
+
+/* Doubles the bucket array, keeping the old one if out of memory */
+static void hosts_grow(hosts_table* t){
+    size_t newMask = (t->mask << 1) | 1;
+    hosts_entry** buckets = calloc(newMask + 1, sizeof(hosts_entry*));
+    hosts_entry* e;
+    hosts_entry* next;
+    size_t i;
+
+    if(!buckets){
+	return;
+    }
+
+    for(i=0; i<=t->mask; i++){
+	for(e = t->buckets[i]; e != NULL; e = next){
+	    next = e->next;
+	    e->next = buckets[e->hash & newMask];
+	    buckets[e->hash & newMask] = e;
+	}
+    }
+
+    free(t->buckets);
+    t->buckets = buckets;
+    t->mask = newMask;
+}
+
+/* Add addr to name's addresses, returns UTIL_SUCCESS or UTIL_FAILURE */
+static int hosts_add(hosts_table* t, const char* name, int family,
+		     const void* addr){
+    unsigned long hash = hosts_hash(name, strlen(name));
+    hosts_entry* e = hosts_find(t, hash, name);
+    util_addr* addrs;
+
+    if(!e){
+	e = malloc(sizeof(hosts_entry) + strlen(name) + 1);
+	if(!e){
+	    return UTIL_FAILURE;
+	}
+	e->hash = hash;
+	e->num_addrs = 0;
+	e->addrs = NULL;
+	strcpy(e->name, name);
+	e->next = t->buckets[hash & t->mask];
+	t->buckets[hash & t->mask] = e;
+	if(++t->count > t->mask){
+	    hosts_grow(t);
+	}
+    }
+    if(e->num_addrs == UTIL_MAX_ADDRS){
+	return UTIL_SUCCESS;
+    }
+
+    addrs = realloc(e->addrs, sizeof(util_addr) * (e->num_addrs + 1));
+    if(!addrs){
+	return UTIL_FAILURE;
+    }
+    e->addrs = addrs;
+    e->num_addrs = util_addr_add(e->addrs, e->num_addrs, e->num_addrs + 1,
+				 family, addr);
+
+    return UTIL_SUCCESS;
+}
+
+static int hosts_open(util_backend* b, const char* arg){
+    unsigned char addr[sizeof(struct in6_addr)];
+    char line[HOSTS_LINE];
+    hosts_table* t;
+    FILE* fp;
+    char* ip;
+    char* name;
+    char* save;
+    int family;
+    int lineNum = 0;
+
+    if(!arg){
+	fprintf(stderr, "hosts backend needs a file: hosts:<file>\n");
+	return UTIL_FAILURE;
+    }
+    fp = fopen(arg, "r");
+    if(!fp){
+	perror("Error Opening Hosts File");
+	return UTIL_FAILURE;
+    }
+
+    t = malloc(sizeof(hosts_table));
+    if(t){
+	t->buckets = calloc(HOSTS_INITIAL_BUCKETS, sizeof(hosts_entry*));
+	t->mask = HOSTS_INITIAL_BUCKETS - 1;
+	t->count = 0;
+    }
+    b->state = t;
+    if(!t || !t->buckets){
+	perror("Error on hosts Malloc");
+	fclose(fp);
+	hosts_destroy(b);
+	return UTIL_FAILURE;
+    }
+
+    while(fgets(line, sizeof(line), fp)){
+	lineNum++;
+	line[strcspn(line, "#")] = '\0';
+	ip = strtok_r(line, " \t\r\n", &save);
+	if(!ip){
+	    continue;
+	}
+	if(inet_pton(AF_INET, ip, addr) == 1){
+	    family = AF_INET;
+	}
+	else if(inet_pton(AF_INET6, ip, addr) == 1){
+	    family = AF_INET6;
+	}
+	else{
+	    fprintf(stderr, "%s:%d: bad address %s\n", arg, lineNum, ip);
+	    continue;
+	}
+	while((name = strtok_r(NULL, " \t\r\n", &save)) != NULL){
+	    if(hosts_add(t, name, family, addr)){
+		perror("Error on hosts Malloc");
+		fclose(fp);
+		hosts_destroy(b);
+		return UTIL_FAILURE;
+	    }
+	}
+    }
+    fclose(fp);
+
+    return UTIL_SUCCESS;
+}
+
+static int hosts_lookup(util_backend* b, const char* hostname,
+			util_addr* addrs, int* num_addrs, int maxAddrs){
+    hosts_table* t = b->state;
+    hosts_entry* e = hosts_find(t, hosts_hash(hostname, strlen(hostname)),
+				hostname);
+    int i;
+
+    if(!e){
+	return UTIL_NOTFOUND;
+    }
+    *num_addrs = 0;
+    for(i=0; i<e->num_addrs && *num_addrs<maxAddrs; i++){
+	if(util_profile_wants(&b->profile, e->addrs[i].family)){
+	    addrs[(*num_addrs)++] = e->addrs[i];
+	}
+    }
+    if(*num_addrs == 0){
+	/* none of the families the profile asks for */
+	return UTIL_NOTFOUND;
+    }
+
+    return UTIL_SUCCESS;
+}
+
+static void hosts_destroy(util_backend* b){
+    hosts_table* t = b->state;
+    hosts_entry* e;
+    hosts_entry* next;
+    size_t i;
+
+    if(!t){
+	return;
+    }
+    for(i=0; t->buckets && i<=t->mask; i++){
+	for(e = t->buckets[i]; e != NULL; e = next){
+	    next = e->next;
+	    free(e->addrs);
+	    free(e);
+	}
+    }
+    free(t->buckets);
+    free(t);
+    b->state = NULL;
+}
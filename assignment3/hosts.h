@@ -0,0 +1,40 @@
+/*
+ * File: hosts.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a resolver backend that answers from
+ *      a table loaded from a hosts-style file: one address per line
+ *      followed by the names it belongs to, with # comments. A name
+ *      listed on several lines gets every address. Names not in the
+ *      file are not found. The table is read-only once loaded, so
+ *      lookups take no locks.
+ *
+ */
+
+#ifndef HOSTS_H
+#define HOSTS_H
+
+#include "util.h"
+
+#define HOSTS_INITIAL_BUCKETS 1024
+#define HOSTS_LINE 4096
+
+typedef struct hosts_entry_s{
+    struct hosts_entry_s* next;
+    unsigned long hash;
+    int num_addrs;
+    util_addr* addrs;
+    char name[];
+} hosts_entry;
+
+typedef struct hosts_table_s{
+    hosts_entry** buckets;
+    size_t mask;
+    size_t count;
+} hosts_table;
+
+/* Backend "hosts:<file>" */
+extern const util_backend_ops hosts_backend_ops;
+
+#endif
@@ -0,0 +1,477 @@
+/*
+ * File: mpmcqueue.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a bounded, lock-free,
+ *      multi-producer multi-consumer FIFO queue. Every slot carries a
+ *      sequence number that tells producers and consumers whose turn
+ *      it is, so head and tail are only ever advanced with a CAS.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "mpmcqueue.h"
+
+/* Wake threads blocked on cond if there are any. The fence pairs with
+ * the waiter count increment so a waiter either sees our update on its
+ * retry or is counted here and gets signalled. */
+static void mpmc_wake(mpmc_queue* q, int* waiters, pthread_cond_t* cond,
+		      int count, int locked){
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(waiters, __ATOMIC_RELAXED) > 0){
+	if(!locked){
+	    pthread_mutex_lock(&q->wait_lock);
+	}
+	if(count > 1){
+	    pthread_cond_broadcast(cond);
+	}
+	else{
+	    pthread_cond_signal(cond);
+	}
+	if(!locked){
+	    pthread_mutex_unlock(&q->wait_lock);
+	}
+    }
+}
+
+int mpmc_queue_init(mpmc_queue* q, int size){
+
+    size_t capacity = 1;
+    size_t i;
+
+    /* user specified size or default */
+    if(size <= 0) {
+	size = QUEUEMAXSIZE;
+    }
+
+    /* round up to a power of two so positions can be masked */
+    while(capacity < (size_t)size){
+	capacity <<= 1;
+    }
+
+    /* malloc array */
+    q->array = malloc(sizeof(mpmc_slot) * capacity);
+    if(!(q->array)){
+	perror("Error on queue Malloc");
+	return QUEUE_FAILURE;
+    }
+
+    /* slot i is free for the producer at position i */
+    for(i=0; i < capacity; ++i){
+	q->array[i].sequence = i;
+	q->array[i].payload = NULL;
+    }
+
+    q->mask = capacity - 1;
+    q->maxSize = (int)capacity;
+    q->head = 0;
+    q->tail = 0;
+    q->closed = 0;
+    q->push_waiters = 0;
+    q->pop_waiters = 0;
+
+    if(pthread_mutex_init(&q->wait_lock, NULL) ||
+       pthread_cond_init(&q->not_full, NULL) ||
+       pthread_cond_init(&q->not_empty, NULL)){
+	fprintf(stderr, "Error on queue wait setup\n");
+	free(q->array);
+	return QUEUE_FAILURE;
+    }
+
+    return q->maxSize;
+}
+
+int mpmc_queue_is_empty(mpmc_queue* q){
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+    return (intptr_t)(tail - head) <= 0;
+}
+
+int mpmc_queue_is_full(mpmc_queue* q){
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+    return (intptr_t)(tail - head) >= (intptr_t)q->maxSize;
+}
+
+int mpmc_queue_size(mpmc_queue* q){
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    intptr_t size = (intptr_t)(tail - head);
+
+    if(size < 0){
+	return 0;
+    }
+    return size > q->maxSize ? q->maxSize : (int)size;
+}
+
+static int mpmc_try_push(mpmc_queue* q, void* new_payload){
+
+    mpmc_slot* slot;
+    size_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    size_t seq;
+    intptr_t diff;
+
+    for(;;){
+	slot = &q->array[pos & q->mask];
+	seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	diff = (intptr_t)seq - (intptr_t)pos;
+
+	if(diff == 0){
+	    /* slot is free, try to claim position */
+	    if(__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+					   __ATOMIC_RELAXED,
+					   __ATOMIC_RELAXED)){
+		break;
+	    }
+	}
+	else if(diff < 0){
+	    /* slot still holds the item from the previous lap */
+	    return QUEUE_FAILURE;
+	}
+	else{
+	    /* another producer got here first */
+	    pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	}
+    }
+
+    slot->payload = new_payload;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    return QUEUE_SUCCESS;
+}
+
+static void* mpmc_try_pop(mpmc_queue* q){
+
+    mpmc_slot* slot;
+    void* ret_payload;
+    size_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    size_t seq;
+    intptr_t diff;
+
+    for(;;){
+	slot = &q->array[pos & q->mask];
+	seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+	if(diff == 0){
+	    /* slot is filled, try to claim position */
+	    if(__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+					   __ATOMIC_RELAXED,
+					   __ATOMIC_RELAXED)){
+		break;
+	    }
+	}
+	else if(diff < 0){
+	    /* producer has not filled this slot yet */
+	    return NULL;
+	}
+	else{
+	    /* another consumer got here first */
+	    pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	}
+    }
+
+    ret_payload = slot->payload;
+    slot->payload = NULL;
+    /* hand the slot to the producer one lap ahead */
+    __atomic_store_n(&slot->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+
+    return ret_payload;
+}
+
+/* Claims up to n consecutive free positions with a single CAS */
+static int mpmc_try_push_n(mpmc_queue* q, void** payloads, int n){
+
+    mpmc_slot* slot;
+    size_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    size_t seq;
+    intptr_t diff;
+    int i;
+    int count;
+
+    if(n <= 0){
+	return 0;
+    }
+
+    for(;;){
+	/* count how many slots from pos on are free */
+	for(count=0; count<n; count++){
+	    slot = &q->array[(pos + count) & q->mask];
+	    seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	    if(seq != pos + count){
+		break;
+	    }
+	}
+
+	if(count > 0){
+	    if(__atomic_compare_exchange_n(&q->tail, &pos, pos + count, 1,
+					   __ATOMIC_RELAXED,
+					   __ATOMIC_RELAXED)){
+		break;
+	    }
+	    continue;
+	}
+
+	diff = (intptr_t)seq - (intptr_t)pos;
+	if(diff < 0){
+	    return 0;
+	}
+	pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+
+    for(i=0; i<count; i++){
+	slot = &q->array[(pos + i) & q->mask];
+	slot->payload = payloads[i];
+	__atomic_store_n(&slot->sequence, pos + i + 1, __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+/* Claims up to n consecutive filled positions with a single CAS */
+static int mpmc_try_pop_n(mpmc_queue* q, void** payloads, int n){
+
+    mpmc_slot* slot;
+    size_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    size_t seq;
+    intptr_t diff;
+    int i;
+    int count;
+
+    if(n <= 0){
+	return 0;
+    }
+
+    for(;;){
+	/* count how many slots from pos on are filled */
+	for(count=0; count<n; count++){
+	    slot = &q->array[(pos + count) & q->mask];
+	    seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	    if(seq != pos + count + 1){
+		break;
+	    }
+	}
+
+	if(count > 0){
+	    if(__atomic_compare_exchange_n(&q->head, &pos, pos + count, 1,
+					   __ATOMIC_RELAXED,
+					   __ATOMIC_RELAXED)){
+		break;
+	    }
+	    continue;
+	}
+
+	diff = (intptr_t)seq - (intptr_t)(pos + 1);
+	if(diff < 0){
+	    return 0;
+	}
+	pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+
+    for(i=0; i<count; i++){
+	slot = &q->array[(pos + i) & q->mask];
+	payloads[i] = slot->payload;
+	slot->payload = NULL;
+	__atomic_store_n(&slot->sequence, pos + i + q->mask + 1,
+			 __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+int mpmc_queue_push(mpmc_queue* q, void* new_payload){
+
+    if(mpmc_try_push(q, new_payload) == QUEUE_FAILURE){
+	return QUEUE_FAILURE;
+    }
+    mpmc_wake(q, &q->pop_waiters, &q->not_empty, 1, 0);
+
+    return QUEUE_SUCCESS;
+}
+
+void* mpmc_queue_pop(mpmc_queue* q){
+
+    void* ret_payload;
+
+    if((ret_payload = mpmc_try_pop(q)) != NULL){
+	mpmc_wake(q, &q->push_waiters, &q->not_full, 1, 0);
+    }
+
+    return ret_payload;
+}
+
+int mpmc_queue_push_n(mpmc_queue* q, void** payloads, int n){
+
+    int count = mpmc_try_push_n(q, payloads, n);
+
+    if(count > 0){
+	mpmc_wake(q, &q->pop_waiters, &q->not_empty, count, 0);
+    }
+
+    return count;
+}
+
+int mpmc_queue_pop_n(mpmc_queue* q, void** payloads, int n){
+
+    int count = mpmc_try_pop_n(q, payloads, n);
+
+    if(count > 0){
+	mpmc_wake(q, &q->push_waiters, &q->not_full, count, 0);
+    }
+
+    return count;
+}
+
+int mpmc_queue_push_wait(mpmc_queue* q, void* new_payload){
+
+    int ret = QUEUE_SUCCESS;
+
+    /* fast path */
+    if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	return QUEUE_FAILURE;
+    }
+    if(mpmc_queue_push(q, new_payload) == QUEUE_SUCCESS){
+	return QUEUE_SUCCESS;
+    }
+
+    /* slow path: register as a waiter, then retry under the lock */
+    pthread_mutex_lock(&q->wait_lock);
+    __atomic_add_fetch(&q->push_waiters, 1, __ATOMIC_SEQ_CST);
+    for(;;){
+	if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	    ret = QUEUE_FAILURE;
+	    break;
+	}
+	if(mpmc_try_push(q, new_payload) == QUEUE_SUCCESS){
+	    mpmc_wake(q, &q->pop_waiters, &q->not_empty, 1, 1);
+	    break;
+	}
+	pthread_cond_wait(&q->not_full, &q->wait_lock);
+    }
+    __atomic_sub_fetch(&q->push_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->wait_lock);
+
+    return ret;
+}
+
+void* mpmc_queue_pop_wait(mpmc_queue* q){
+
+    void* ret_payload;
+
+    /* fast path */
+    if((ret_payload = mpmc_queue_pop(q)) != NULL){
+	return ret_payload;
+    }
+
+    /* slow path: register as a waiter, then retry under the lock */
+    pthread_mutex_lock(&q->wait_lock);
+    __atomic_add_fetch(&q->pop_waiters, 1, __ATOMIC_SEQ_CST);
+    for(;;){
+	if((ret_payload = mpmc_try_pop(q)) != NULL){
+	    mpmc_wake(q, &q->push_waiters, &q->not_full, 1, 1);
+	    break;
+	}
+	if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	    /* a push may have landed between the pop and the check */
+	    ret_payload = mpmc_try_pop(q);
+	    break;
+	}
+	pthread_cond_wait(&q->not_empty, &q->wait_lock);
+    }
+    __atomic_sub_fetch(&q->pop_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->wait_lock);
+
+    return ret_payload;
+}
+
+int mpmc_queue_push_n_wait(mpmc_queue* q, void** payloads, int n){
+
+    int pushed = 0;
+    int count;
+
+    /* fast path */
+    if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	return 0;
+    }
+    pushed = mpmc_queue_push_n(q, payloads, n);
+    if(pushed == n){
+	return pushed;
+    }
+
+    /* slow path: register as a waiter, then retry under the lock */
+    pthread_mutex_lock(&q->wait_lock);
+    __atomic_add_fetch(&q->push_waiters, 1, __ATOMIC_SEQ_CST);
+    while(pushed < n){
+	if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	    break;
+	}
+	count = mpmc_try_push_n(q, payloads + pushed, n - pushed);
+	if(count > 0){
+	    mpmc_wake(q, &q->pop_waiters, &q->not_empty, count, 1);
+	    pushed += count;
+	    continue;
+	}
+	pthread_cond_wait(&q->not_full, &q->wait_lock);
+    }
+    __atomic_sub_fetch(&q->push_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->wait_lock);
+
+    return pushed;
+}
+
+int mpmc_queue_pop_n_wait(mpmc_queue* q, void** payloads, int n){
+
+    int count;
+
+    /* fast path */
+    if((count = mpmc_queue_pop_n(q, payloads, n)) > 0){
+	return count;
+    }
+
+    /* slow path: register as a waiter, then retry under the lock */
+    pthread_mutex_lock(&q->wait_lock);
+    __atomic_add_fetch(&q->pop_waiters, 1, __ATOMIC_SEQ_CST);
+    for(;;){
+	if((count = mpmc_try_pop_n(q, payloads, n)) > 0){
+	    mpmc_wake(q, &q->push_waiters, &q->not_full, count, 1);
+	    break;
+	}
+	if(__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)){
+	    /* a push may have landed between the pop and the check */
+	    count = mpmc_try_pop_n(q, payloads, n);
+	    break;
+	}
+	pthread_cond_wait(&q->not_empty, &q->wait_lock);
+    }
+    __atomic_sub_fetch(&q->pop_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->wait_lock);
+
+    return count;
+}
+
+void mpmc_queue_close(mpmc_queue* q){
+    pthread_mutex_lock(&q->wait_lock);
+    __atomic_store_n(&q->closed, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->wait_lock);
+}
+
+void mpmc_queue_cleanup(mpmc_queue* q)
+{
+    while(!mpmc_queue_is_empty(q)){
+	mpmc_try_pop(q);
+    }
+
+    free(q->array);
+    q->array = NULL;
+
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    pthread_mutex_destroy(&q->wait_lock);
+}
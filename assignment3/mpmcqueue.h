@@ -0,0 +1,125 @@
+/*
+ * File: mpmcqueue.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a bounded, lock-free, multi-producer
+ *      multi-consumer FIFO queue. It mirrors the interface of queue.h
+ *      but may be used from many threads without an external mutex.
+ *
+ */
+
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "queue.h"
+
+#define MPMC_CACHE_LINE 64
+
+typedef struct mpmc_slot_s{
+    size_t sequence;
+    void* payload;
+} mpmc_slot;
+
+typedef struct mpmc_queue_s{
+    mpmc_slot* array;
+    size_t mask;
+    int maxSize;
+    char pad0[MPMC_CACHE_LINE];
+    size_t head;
+    char pad1[MPMC_CACHE_LINE - sizeof(size_t)];
+    size_t tail;
+    char pad2[MPMC_CACHE_LINE - sizeof(size_t)];
+    int closed;
+    int push_waiters;
+    int pop_waiters;
+    pthread_mutex_t wait_lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+} mpmc_queue;
+
+/* Function to initilze a new queue
+ * size is rounded up to the next power of two
+ * On success, returns queue size
+ * On failure, returns QUEUE_FAILURE
+ * Must be called before queue is used
+ */
+int mpmc_queue_init(mpmc_queue* q, int size);
+
+/* Function to test if queue is empty
+ * Returns 1 if empty, 0 otherwise
+ * Only a snapshot while other threads are pushing or popping
+ */
+int mpmc_queue_is_empty(mpmc_queue* q);
+
+/* Function to test if queue is full
+ * Returns 1 if full, 0 otherwise
+ * Only a snapshot while other threads are pushing or popping
+ */
+int mpmc_queue_is_full(mpmc_queue* q);
+
+/* Function to count items in the queue
+ * Only a snapshot while other threads are pushing or popping
+ */
+int mpmc_queue_size(mpmc_queue* q);
+
+/* Function add payload to end of FIFO queue
+ * Returns QUEUE_SUCCESS if the push successeds.
+ * Returns QUEUE_FAILURE if the queue is full
+ */
+int mpmc_queue_push(mpmc_queue* q, void* payload);
+
+/* Function to return element from queue in FIFO order
+ * Returns NULL pointer if queue is empty
+ */
+void* mpmc_queue_pop(mpmc_queue* q);
+
+/* Function add payload to end of FIFO queue, blocking while full
+ * Returns QUEUE_SUCCESS if the push successeds.
+ * Returns QUEUE_FAILURE if the queue has been closed
+ */
+int mpmc_queue_push_wait(mpmc_queue* q, void* payload);
+
+/* Function to return element from queue in FIFO order,
+ * blocking while empty
+ * Returns NULL pointer once the queue is closed and drained
+ */
+void* mpmc_queue_pop_wait(mpmc_queue* q);
+
+/* Function to add up to n payloads to the end of the queue
+ * in one claim of the tail
+ * Returns the number of payloads pushed, 0 if the queue is full
+ */
+int mpmc_queue_push_n(mpmc_queue* q, void** payloads, int n);
+
+/* Function to remove up to n payloads from the front of the queue
+ * in one claim of the head
+ * Returns the number of payloads popped, 0 if the queue is empty
+ */
+int mpmc_queue_pop_n(mpmc_queue* q, void** payloads, int n);
+
+/* Function to push all n payloads, blocking while full
+ * Returns the number pushed, less than n only if the queue is closed
+ */
+int mpmc_queue_push_n_wait(mpmc_queue* q, void** payloads, int n);
+
+/* Function to pop up to n payloads, blocking while empty
+ * Returns the number popped, 0 once the queue is closed and drained
+ */
+int mpmc_queue_pop_n_wait(mpmc_queue* q, void** payloads, int n);
+
+/* Function to close the queue
+ * Wakes all blocked threads; later pushes fail and pops
+ * drain what is left. Producers must be done pushing.
+ */
+void mpmc_queue_close(mpmc_queue* q);
+
+/* Function to free queue memory
+ * Must only be called once no other thread uses the queue
+ */
+void mpmc_queue_cleanup(mpmc_queue* q);
+
+#endif
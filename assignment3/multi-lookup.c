@@ -11,199 +11,1468 @@
 #include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <ctype.h>
+#include <poll.h>
+#include <sys/stat.h>
 
-#include "queue.h"
+#include "mpmcqueue.h"
+#include "arena.h"
+#include "scan.h"
+#include "cache.h"
+#include "dedupe.h"
+#include "hedge.h"
+#include "hostname.h"
+#include "adns.h"
+#include "outbuf.h"
+#include "pool.h"
+#include "reorder.h"
+#include "resfile.h"
+#include "retry.h"
+#include "shard.h"
+#include "stats.h"
 #include "util.h"
 
 #include "multi-lookup.h"
 
 #define MINARGS 3
-#define USAGE "<inputFilePath> ... <outputFilePath>"
+#define USAGE "[-m] [-C] [-a] [-B] [-u] [-o window] [-H] [-d] [-w snapshot] [-b backend] [-q profile] [-D deadline] [-h backend] [-R retries[:baseMs]] [-s server] [-i inflight] [-p min:max] [-r readers] [-n notfound:transient] [-S text|json] <inputFilePath> ... <outputFilePath>"
+#define OPTSTRING "mCaBuo:Hdw:b:q:D:h:R:s:i:p:r:n:S:"
 #define SBUFSIZE 1025
 #define INPUTFS "%1024s"
 
-queue q;
-pthread_mutex_t q_lock;
+mpmc_queue q;
+int use_shards = 0;
+shard_set shards;
+int next_home = 0;
 pthread_mutex_t file_lock;
-pthread_mutex_t finished_lock;
-int requesters_finished = 0;
+pthread_mutex_t* output_lock = NULL;
+int use_mmap = 0;
+int use_cache = 1;
+cache results;
+int use_async = 0;
+int binary_output = 0;
+int use_unique = 0;
+dedupe unique;
+unsigned long invalid_names = 0;
+int use_order = 0;
+unsigned long order_window = REORDER_DEFAULT_WINDOW;
+reorder order;
+unsigned long next_seq = 0;
+int max_inflight = ADNS_DEFAULT_INFLIGHT;
+char* backend_spec = NULL;
+int use_profile = 0;
+util_profile query_profile;
+long deadline_ms = 0;
+char* hedge_spec = NULL;
+util_backend hedge_backend;
+int use_hedge = 0;
+hedge hedger;
+int retry_max = 0;
+long retry_base_ms = RETRY_DEFAULT_BASE_MS;
+retry retrier;
+unsigned long outstanding = 0;
+pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t drained = PTHREAD_COND_INITIALIZER;
+char dns_spec[SBUFSIZE];
+util_backend backend;
+pool resolvers;
+int pool_min = MIN_RESOLVER_THREADS;
+int pool_max = MAX_RESOLVER_THREADS;
+int controller_done = 0;
+input_range* ranges = NULL;
+int num_ranges = 0;
+int next_range = 0;
+neg_stats negative[NEG_CLASSES] = {
+    { NEG_NOTFOUND_TTL_MS, 0, 0, 0 },
+    { NEG_TRANSIENT_TTL_MS, 0, 0, 0 },
+};
+int stats_json = 0;
+volatile sig_atomic_t stats_requested = 0;
+int daemon_mode = 0;
+char* snapshot_path = NULL;
+volatile sig_atomic_t stop_requested = 0;
 
-void* requester(void* filename) {
-    char* file = filename;
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Push requests onto q, or onto one shard when sharded
+ * Returns the number pushed, fewer than n only if closed
+ */
+static int push_requests(int shard, request** reqs, int n) {
+    unsigned long long start;
+    int pushed;
+
+    if (use_shards) {
+        pushed = shard_push_n(&shards, shard, (void**) reqs, n);
+    } else {
+        pushed = mpmc_queue_push_n(&q, (void**) reqs, n);
+    }
+
+    /* Only Time The Push When The Queue Is Full */
+    if (pushed < n) {
+        start = stats_now_ns();
+        if (use_shards) {
+            pushed += shard_push_n_wait(&shards, shard,
+                    (void**) (reqs + pushed), n - pushed);
+        } else {
+            pushed += mpmc_queue_push_n_wait(&q, (void**) (reqs + pushed),
+                    n - pushed);
+        }
+        stats_record(STATS_QUEUE_PUSH, stats_now_ns() - start, 1);
+    } else {
+        stats_record(STATS_QUEUE_PUSH, 0, 0);
+    }
+    return pushed;
+}
+
+/* Normalize names, releasing invalid ones and repeats
+ * Names copied into the arena are rewritten in place, views into a
+ * mapping are copied first but only if they change
+ * Returns the number kept, packed at the front of reqs
+ */
+static int unique_requests(request** reqs, int n, arena* names) {
+    request* req;
+    request* copy;
+    char* name;
+    size_t len;
+    int kept = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        req = reqs[i];
+        if (!hostname_is_normal(req->name, req->len)) {
+            name = (char*)(req + 1);
+            if (req->name != name) {
+                copy = arena_alloc(names, sizeof(request) + req->len + 1);
+                if (copy == NULL) {
+                    fprintf(stderr, "Error allocating name: %.*s\n",
+                            (int)req->len, req->name);
+                    arena_release(req);
+                    continue;
+                }
+                name = (char*)(copy + 1);
+                copy->name = req->name;
+                copy->len = req->len;
+                arena_release(req);
+                req = copy;
+            }
+            len = hostname_normalize(req->name, req->len, name);
+            if (len == 0) {
+                fprintf(stderr, "Invalid hostname: %.*s\n",
+                        (int)req->len, req->name);
+                __atomic_add_fetch(&invalid_names, 1, __ATOMIC_RELAXED);
+                arena_release(req);
+                continue;
+            }
+            name[len] = '\0';
+            req->name = name;
+            req->len = len;
+        }
+
+        /* A Name That Could Not Be Stored Is Looked Up Anyway */
+        if (dedupe_add(&unique, req->name, req->len) == 0) {
+            arena_release(req);
+            continue;
+        }
+        reqs[kept++] = req;
+    }
+    return kept;
+}
+
+/* Push a batch of requests, releasing any the queue refused
+ * Sharded batches are grouped by shard and pushed a run at a time
+ * Returns 0 on success, -1 if the queue was closed
+ */
+static int enqueue_requests(request** reqs, int n, arena* names) {
+    int shard_ids[REQUESTER_BATCH];
+    request* req;
+    int pushed = 0;
+    int shard;
+    int run;
+    int i;
+    int j;
+
+    /* Drop Repeats Before They Take A Queue Slot */
+    if (use_unique && (n = unique_requests(reqs, n, names)) == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        reqs[i]->attempts = 0;
+    }
+
+    /* Count Names Until Written, Retries Keep The Queue Open */
+    if (retry_max > 0) {
+        __atomic_add_fetch(&outstanding, n, __ATOMIC_RELEASE);
+    }
+
+    /* Number Names In Input Order, Only One Requester Runs When Ordered */
+    if (use_order) {
+        for (i = 0; i < n; i++) {
+            reqs[i]->seq = next_seq++;
+        }
+        reorder_wait(&order, reqs[n - 1]->seq);
+    }
+
+    if (!use_shards) {
+        pushed = push_requests(0, reqs, n);
+    } else {
+        /* Insertion Sort By Shard, Batches Are Small */
+        for (i = 0; i < n; i++) {
+            req = reqs[i];
+            shard = shard_of(&shards, req->name, req->len);
+            for (j = i; j > 0 && shard_ids[j - 1] > shard; j--) {
+                reqs[j] = reqs[j - 1];
+                shard_ids[j] = shard_ids[j - 1];
+            }
+            reqs[j] = req;
+            shard_ids[j] = shard;
+        }
+        while (pushed < n) {
+            for (run = 1; pushed + run < n &&
+                    shard_ids[pushed + run] == shard_ids[pushed]; run++) {
+            }
+            i = push_requests(shard_ids[pushed], reqs + pushed, run);
+            pushed += i;
+            if (i < run) {
+                break;
+            }
+        }
+    }
+
+    if (pushed < n) {
+        fprintf(stderr, "Queue push failed \n");
+        if (retry_max > 0) {
+            __atomic_sub_fetch(&outstanding, n - pushed, __ATOMIC_RELEASE);
+        }
+        while (pushed < n) {
+            arena_release(reqs[pushed++]);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/* Read names with stdio, copying each into the arena
+ * Only names starting before the end of the range are read
+ */
+static void read_stream(input_range* range, arena* names) {
     FILE* inputfp = NULL;
-    char* payload;
+    request* reqs[REQUESTER_BATCH];
     char hostname[SBUFSIZE];
-
-    printf("%s\n",file);
+    off_t pos = range->start;
+    size_t len;
+    int used;
+    int n = 0;
 
     /* Open Input File */
-    inputfp = fopen(file, "r");
+    inputfp = fopen(range->input->path, "r");
     if(!inputfp){
-        fprintf(stderr, "Error Opening Input File: %s", file);
-        return NULL;
+        fprintf(stderr, "Error Opening Input File: %s", range->input->path);
+        return;
+    }
+    if (pos > 0 && fseeko(inputfp, pos, SEEK_SET)) {
+        fprintf(stderr, "Error Seeking Input File: %s", range->input->path);
+        fclose(inputfp);
+        return;
     }
 
     /* Read File and Process*/
-    while(fscanf(inputfp, INPUTFS, hostname) > 0) {
-        pthread_mutex_lock(&q_lock);
-        while(queue_is_full(&q)) { // Sleep while queue is full
-            pthread_mutex_unlock(&q_lock);
-            usleep(rand() % 100);
-            pthread_mutex_lock(&q_lock);
-        }
-        //printf("%s\n",hostname);
-
-        /* Prepare Payload */
-        payload = malloc(sizeof(hostname));
-        strcpy(payload,hostname);
+    while(1) {
+        /* Read a Batch of Hostnames */
+        n = 0;
+        while(n < REQUESTER_BATCH) {
+            used = 0;
+            if (fscanf(inputfp, " %n", &used) == EOF) {
+                break;
+            }
+            pos += used;
+            if ((range->end >= 0 && pos >= range->end) ||
+                    fscanf(inputfp, INPUTFS "%n", hostname, &used) <= 0) {
+                break;
+            }
+            pos += used;
 
-        /* Push to Queue */
-        while (queue_push(&q, (void*) payload) == QUEUE_FAILURE) {
-            fprintf(stderr, "Queue push failed \n");
+            /* Prepare Payload, Name Stored Right After Request */
+            len = strlen(hostname);
+            reqs[n] = arena_alloc(names, sizeof(request) + len + 1);
+            if (reqs[n] == NULL) {
+                fprintf(stderr, "Error allocating name: %s\n", hostname);
+                continue;
+            }
+            memcpy(reqs[n] + 1, hostname, len + 1);
+            reqs[n]->name = (char*)(reqs[n] + 1);
+            reqs[n]->len = len;
+            n++;
+        }
+        if (n == 0 || enqueue_requests(reqs, n, names)) {
+            break;
         }
-        pthread_mutex_unlock(&q_lock);
     }
 
     /* Close Input File */
     if (fclose(inputfp)) {
         fprintf(stderr, "Error closing output file \n");
     }
+}
+
+/* Copy the names in data[0..len) into the arena and enqueue them
+ * Returns 0 on success, -1 if the queue was closed
+ */
+static int enqueue_tokens(const char* data, size_t len, arena* names) {
+    request* reqs[REQUESTER_BATCH];
+    scan_cursor cursor;
+    const char* token;
+    size_t tlen;
+    int n;
+
+    scan_cursor_init(&cursor, data, 0, len);
+    do {
+        n = 0;
+        while (n < REQUESTER_BATCH &&
+                (tlen = scan_next_token(&cursor, &token, SBUFSIZE - 1)) > 0) {
+            reqs[n] = arena_alloc(names, sizeof(request) + tlen + 1);
+            if (reqs[n] == NULL) {
+                fprintf(stderr, "Error allocating name: %.*s\n",
+                        (int)tlen, token);
+                continue;
+            }
+            memcpy(reqs[n] + 1, token, tlen);
+            ((char*)(reqs[n] + 1))[tlen] = '\0';
+            reqs[n]->name = (char*)(reqs[n] + 1);
+            reqs[n]->len = tlen;
+            n++;
+        }
+        if (n > 0 && enqueue_requests(reqs, n, names)) {
+            return -1;
+        }
+    } while (n == REQUESTER_BATCH);
 
-    printf("Finished %s\n",file);
     return 0;
 }
 
-void* resolver(void *outputfp) {
-    char ips[100][INET6_ADDRSTRLEN];
-    char lastip[INET6_ADDRSTRLEN];
-    char * hostname = NULL;
-    int num_ips = 0;
-    int i = 0;
-
-    /* Loop While Requesters or Data In Queue */
-    pthread_mutex_lock(&q_lock);
-    pthread_mutex_lock(&finished_lock);
-    while (!queue_is_empty(&q) || !requesters_finished) {
-        pthread_mutex_unlock(&finished_lock);
-        if ((hostname = (char*)queue_pop(&q)) == NULL) {
-            pthread_mutex_unlock(&q_lock);
-            //fprintf(stderr, "Queue pop failed \n");
-        } else { //Pop from queue was succsesful
-
-            pthread_mutex_unlock(&q_lock);
-            //printf("%s\n",hostname);
-
-            /* Lookup hostname and get IP string */
-            num_ips = 0;
-            if(mydnslookup(hostname, ips, &num_ips, sizeof(ips[0]))
-                    == UTIL_FAILURE){
-                fprintf(stderr, "dnslookup error: %s\n", hostname);
-                strncpy(ips[0], "", sizeof(ips));
-                num_ips++;
-            }
-            
-            /* Write to Output File */
-            pthread_mutex_lock(&file_lock);
-            fprintf(outputfp, "%s", hostname);
-            for(i = 0; i < num_ips; i++) {
-                    if(strcmp(lastip, ips[i]) != 0) {
-                        fprintf(outputfp, ",%s", ips[i]);
-                        strcpy(lastip,ips[i]);
-                    }
-                    memset(ips[i],0,strlen(ips[i]));
-            }
-            fprintf(outputfp, "\n");
-            pthread_mutex_unlock(&file_lock);
-            free(hostname);
-        }
-
-        pthread_mutex_lock(&q_lock);
-        pthread_mutex_lock(&finished_lock);
-
-    }
-    pthread_mutex_unlock(&finished_lock);
-    pthread_mutex_unlock(&q_lock);
+/* Read names from stdin ("-"), a pipe or a FIFO as they arrive
+ * Polls so a stop request is noticed; in daemon mode a FIFO is
+ * reopened each time all of its writers close it
+ */
+static void read_pipe(input_range* range, arena* names) {
+    const char* path = range->input->path;
+    char buf[PIPE_BUFFER_SIZE];
+    struct pollfd pfd;
+    int is_stdin = strcmp(path, "-") == 0;
+    size_t held = 0;
+    size_t end;
+    ssize_t got;
+    int fd;
+
+    fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        fprintf(stderr, "Error Opening Input File: %s", path);
+        return;
+    }
+
+    while (!stop_requested) {
+        /* Wait For Input, Waking To Check For A Stop */
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, PIPE_POLL_MS) <= 0) {
+            continue;
+        }
+        got = read(fd, buf + held, sizeof(buf) - held);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            fprintf(stderr, "Error Reading Input File: %s", path);
+            break;
+        }
+
+        /* Every Writer Closed, Wait For The Next In Daemon Mode */
+        if (got == 0) {
+            if (!daemon_mode || is_stdin) {
+                break;
+            }
+            close(fd);
+            if ((fd = open(path, O_RDONLY | O_NONBLOCK)) < 0) {
+                fprintf(stderr, "Error Reopening Input File: %s", path);
+                return;
+            }
+            continue;
+        }
+        held += got;
+
+        /* Names Up To The Last Whitespace Are Whole */
+        for (end = held; end > 0 && !isspace((unsigned char)buf[end - 1]);
+                end--) {
+        }
+        if (end == 0 && held == sizeof(buf)) {
+            end = held;
+        }
+        if (enqueue_tokens(buf, end, names)) {
+            break;
+        }
+        memmove(buf, buf + end, held - end);
+        held -= end;
+    }
+
+    /* A Last Name With No Newline After It */
+    if (held > 0) {
+        enqueue_tokens(buf, held, names);
+    }
+    if (!is_stdin) {
+        close(fd);
+    }
+}
+
+/* Read names from a mapping, enqueueing views into it
+ * The mapping stays until main unmaps it after the resolvers finish
+ */
+static void read_mapped(input_range* range, arena* names) {
+    const scan_map* map = &range->input->map;
+    request* reqs[REQUESTER_BATCH];
+    scan_cursor cursor;
+    const char* token;
+    size_t len;
+    int n = 0;
+
+    scan_cursor_init(&cursor, map->data, range->start,
+            range->end >= 0 ? (size_t)range->end : map->size);
+
+    /* Tokenize In Place and Process */
+    while(1) {
+        n = 0;
+        while (n < REQUESTER_BATCH &&
+                (len = scan_next_token(&cursor, &token, SBUFSIZE - 1)) > 0) {
+            if ((reqs[n] = arena_alloc(names, sizeof(request))) == NULL) {
+                fprintf(stderr, "Error allocating name request\n");
+                continue;
+            }
+            reqs[n]->name = token;
+            reqs[n]->len = len;
+            n++;
+        }
+        if (n == 0 || enqueue_requests(reqs, n, names)) {
+            break;
+        }
+    }
+}
+
+void* requester(void* arg) {
+    input_range* range;
+    arena names;
+    char label[PATH_MAX + 64];
+    int r;
+
+    (void) arg;
+    stats_thread_start("requester");
+
+    /* Requests Are Packed Into Chunks Freed Once Resolved */
+    if (arena_init(&names) == ARENA_FAILURE) {
+        fprintf(stderr, "Error creating name arena\n");
+        return NULL;
+    }
+
+    /* Take Ranges Until The Work List Is Empty */
+    while ((r = __atomic_fetch_add(&next_range, 1, __ATOMIC_RELAXED))
+            < num_ranges) {
+        range = &ranges[r];
+        if (range->start > 0 || range->end < range->input->size) {
+            snprintf(label, sizeof(label), "%s [%lld,%lld)",
+                    range->input->path, (long long)range->start,
+                    (long long)range->end);
+        } else {
+            snprintf(label, sizeof(label), "%s", range->input->path);
+        }
+        printf("%s\n", label);
+
+        if (range->input->size < 0) {
+            read_pipe(range, &names);
+        } else if (use_mmap) {
+            read_mapped(range, &names);
+        } else {
+            read_stream(range, &names);
+        }
+
+        printf("Finished %s\n", label);
+    }
+    arena_cleanup(&names);
+
     return 0;
 }
 
+/* Build the work list, splitting files over INPUT_SHARD_BYTES into
+ * ranges that start and end on whitespace
+ * Returns the number of ranges or -1 on failure
+ */
+static int split_inputs(input_file* inputs, int num_files) {
+    struct stat st;
+    off_t start;
+    off_t end;
+    int max_ranges = 0;
+    int fd;
+    int f;
+
+    /* Size Every File First To Bound The Work List */
+    for (f = 0; f < num_files; f++) {
+        /* stat, Not open, So A FIFO Without A Writer Does Not Block */
+        inputs[f].size = -1;
+        if (strcmp(inputs[f].path, "-") != 0 &&
+                !stat(inputs[f].path, &st) && S_ISREG(st.st_mode)) {
+            inputs[f].size = st.st_size;
+        }
+        max_ranges += inputs[f].size > INPUT_SHARD_BYTES ?
+                inputs[f].size / INPUT_SHARD_BYTES + 1 : 1;
+    }
+
+    ranges = malloc(sizeof(input_range) * max_ranges);
+    if (!ranges) {
+        return -1;
+    }
+
+    for (f = 0; f < num_files; f++) {
+        /* Mapped Files Are Mapped Once And Shared By Their Ranges */
+        if (use_mmap && inputs[f].size >= 0 && scan_map_file(inputs[f].path, &inputs[f].map)
+                == SCAN_FAILURE) {
+            fprintf(stderr, "Error Mapping Input File: %s\n", inputs[f].path);
+            continue;
+        }
+
+        /* Unknown Sizes Are Read Whole By One Requester */
+        if (inputs[f].size <= INPUT_SHARD_BYTES) {
+            ranges[num_ranges].input = &inputs[f];
+            ranges[num_ranges].start = 0;
+            ranges[num_ranges].end = inputs[f].size;
+            num_ranges++;
+            continue;
+        }
+
+        fd = open(inputs[f].path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Error Opening Input File: %s", inputs[f].path);
+            continue;
+        }
+        for (start = 0; start < inputs[f].size; start = end) {
+            end = scan_align_fd(fd, start + INPUT_SHARD_BYTES,
+                    inputs[f].size);
+            ranges[num_ranges].input = &inputs[f];
+            ranges[num_ranges].start = start;
+            ranges[num_ranges].end = end;
+            num_ranges++;
+        }
+        close(fd);
+    }
+
+    return num_ranges;
+}
+
+/* Format the result of a failed lookup
+ * Returns the length of the result
+ */
+static size_t format_failure(char* result) {
+    if (binary_output) {
+        return resfile_encode_addrs(result, NULL, 0);
+    }
+    strcpy(result, ",");
+    return 1;
+}
+
+/* Format the addresses as ",ip,ip...", or as a binary address list
+ * with -B; lookups return each address once
+ * Returns the length written to result
+ */
+static size_t format_addrs(const util_addr* addrs, int num_addrs,
+        char* result) {
+    size_t len = 0;
+    int i;
+
+    if (binary_output) {
+        return resfile_encode_addrs(result, addrs, num_addrs);
+    }
+    for(i = 0; i < num_addrs; i++) {
+        result[len++] = ',';
+        len += util_addr_format(&addrs[i], result + len);
+    }
+    return len;
+}
+
+/* Negative cache class of a failed lookup status */
+static neg_stats* neg_class(int status) {
+    return &negative[status == UTIL_NOTFOUND ? NEG_NOTFOUND : NEG_TRANSIENT];
+}
+
+/* How long to cache a result: successes for good, failures by class
+ * A timeout that will be retried is not kept, so the retry looks it up
+ */
+static long result_ttl(int status) {
+    if (status == UTIL_TIMEOUT && retry_max > 0) {
+        return 0;
+    }
+    return status == UTIL_SUCCESS ? CACHE_NO_EXPIRY : neg_class(status)->ttlMs;
+}
+
+/* Count a failed lookup and how long it took */
+static void neg_lookup(int status, unsigned long long us) {
+    neg_stats* n = neg_class(status);
+
+    __atomic_add_fetch(&n->lookups, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&n->lookupUs, us, __ATOMIC_RELAXED);
+}
+
+/* Count a failure answered from the cache */
+static void neg_hit(int status) {
+    if (status != UTIL_SUCCESS) {
+        __atomic_add_fetch(&neg_class(status)->hits, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Print negative hits and the time they saved at the mean failure cost */
+static void neg_report(FILE* fp) {
+    static const char* names[NEG_CLASSES] = { "not found", "transient" };
+    unsigned long long saved = 0;
+    unsigned long long mean;
+    int i;
+
+    for (i = 0; i < NEG_CLASSES; i++) {
+        mean = negative[i].lookups ?
+                negative[i].lookupUs / negative[i].lookups : 0;
+        saved += mean * negative[i].hits;
+        fprintf(fp, "Negative cache: %s %lu hits, %lu lookups, %llu us mean\n",
+                names[i], negative[i].hits, negative[i].lookups, mean);
+    }
+    fprintf(fp, "Negative cache: about %llu ms of lookups saved\n",
+            saved / 1000);
+}
+
+/* Pack the query profile for a snapshot header */
+static int snapshot_profile(void) {
+    return backend.profile.family << 16 | backend.profile.socktype << 8 |
+            backend.profile.addrconfig;
+}
+
+/* Hash the backends answers came from for a snapshot header */
+static unsigned long snapshot_backend(void) {
+    unsigned long h = cache_hash(backend_spec, strlen(backend_spec));
+
+    if (hedge_spec) {
+        h = h * 31 + cache_hash(hedge_spec, strlen(hedge_spec));
+    }
+    return h;
+}
+
+/* Lookup hostname, going through the cache when enabled
+ * Returns the lookup status and the formatted addresses in result
+ */
+static int resolve_name(const char* hostname, size_t hostlen,
+        char* result, size_t* result_len) {
+    util_addr addrs[UTIL_MAX_ADDRS];
+    unsigned long long start;
+    int num_addrs = 0;
+    int status = UTIL_SUCCESS;
+    int cached = CACHE_FAILURE;
+
+    if (use_cache) {
+        cached = cache_acquire(&results, hostname, hostlen, 1, &status,
+                result, MAX_RESULT_LENGTH, result_len);
+        if (cached == CACHE_HIT) {
+            neg_hit(status);
+            return status;
+        }
+    }
+
+    /* Lookup hostname, Text Only Once It Is Written */
+    start = now_ns();
+    if (use_hedge) {
+        status = hedge_lookup(&hedger, hostname, hostlen, addrs, &num_addrs,
+                UTIL_MAX_ADDRS);
+    } else {
+        status = util_lookup(hostname, addrs, &num_addrs, UTIL_MAX_ADDRS);
+    }
+    stats_record(STATS_LOOKUP, now_ns() - start, 0);
+    if (status != UTIL_SUCCESS) {
+        neg_lookup(status, (now_ns() - start) / 1000);
+        *result_len = format_failure(result);
+    } else {
+        *result_len = format_addrs(addrs, num_addrs, result);
+    }
+
+    if (cached == CACHE_MISS) {
+        cache_complete(&results, hostname, hostlen, status,
+                result, *result_len, result_ttl(status));
+    }
+    return status;
+}
+
+/* Take up to n requests without blocking, home's shard first
+ * Returns the number taken
+ */
+static int take_requests(int home, request** reqs, int n) {
+    if (use_shards) {
+        return shard_pop_n(&shards, home, (void**) reqs, n);
+    }
+    return mpmc_queue_pop_n(&q, (void**) reqs, n);
+}
+
+/* Take up to n requests, blocking while there are none
+ * Returns the number taken, 0 once the queue is closed and drained
+ */
+static int take_requests_wait(int home, request** reqs, int n) {
+    if (use_shards) {
+        return shard_pop_n_wait(&shards, home, (void**) reqs, n);
+    }
+    return mpmc_queue_pop_n_wait(&q, (void**) reqs, n);
+}
+
+/* Count requests waiting to be taken */
+static int queue_depth(void) {
+    return use_shards ? shard_size(&shards) : mpmc_queue_size(&q);
+}
+
+/* Write out a resolver's buffered results, and with -o the lines
+ * now in sequence
+ */
+static void flush_results(outbuf* out) {
+    outbuf_flush(out);
+    if (use_order) {
+        reorder_flush(&order);
+    }
+}
+
+/* Count a request written, waking main when it was the last */
+static void finish_request(void) {
+    if (__atomic_sub_fetch(&outstanding, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&drain_lock);
+        pthread_cond_broadcast(&drained);
+        pthread_mutex_unlock(&drain_lock);
+    }
+}
+
+/* Put a retried request back on the queue, called by the timer thread */
+static void retry_request(void* payload, void* arg) {
+    request* req = payload;
+
+    (void) arg;
+    if (push_requests(use_shards ? shard_of(&shards, req->name, req->len)
+                : 0, &req, 1) < 1) {
+        fprintf(stderr, "Queue push failed \n");
+        arena_release(req);
+        finish_request();
+    }
+}
+
+/* Buffer one result line and release its request
+ * A timeout with retries left goes on the retry wheel instead
+ */
+static void write_result(outbuf* out, request* req, int status,
+        const char* result, size_t result_len) {
+    char held[RESFILE_HEAD_SIZE(SBUFSIZE) + MAX_RESULT_LENGTH +
+            RESFILE_RETRY_TEXT];
+    char retries[RESFILE_RETRY_TEXT];
+    size_t retries_len = 0;
+    char* line;
+    size_t len;
+
+    /* Counted Before It Is Scheduled, The Retry May Run At Once */
+    if (status == UTIL_TIMEOUT && req->attempts < retry_max) {
+        req->attempts++;
+        if (retry_schedule(&retrier, req, req->attempts - 1)
+                == RETRY_SUCCESS) {
+            return;
+        }
+        req->attempts--;
+    }
+    if (req->attempts > 0 && !binary_output) {
+        retries_len = sprintf(retries, RESFILE_RETRY_FORMAT, req->attempts);
+    }
+
+    if (status != UTIL_SUCCESS) {
+        fprintf(stderr, "dnslookup error: %.*s\n", (int)req->len, req->name);
+    }
+
+    /* Ordered Lines Wait In The Reorder Buffer Instead */
+    if (use_order) {
+        line = held;
+    } else if (binary_output) {
+        line = outbuf_reserve(out, RESFILE_HEAD_SIZE(req->len) + result_len);
+    } else {
+        line = outbuf_reserve(out, req->len + result_len + retries_len + 1);
+    }
+
+    if (line) {
+        /* Binary Records Carry The Status In Place Of The Separators */
+        if (binary_output) {
+            len = resfile_encode_head(line, req->name, req->len, status,
+                    req->attempts);
+            memcpy(line + len, result, result_len);
+            len += result_len;
+        } else {
+            memcpy(line, req->name, req->len);
+            memcpy(line + req->len, result, result_len);
+            memcpy(line + req->len + result_len, retries, retries_len);
+            len = req->len + result_len + retries_len;
+            line[len++] = '\n';
+        }
+        if (use_order) {
+            reorder_put(&order, req->seq, line, len);
+        } else {
+            outbuf_commit(out, len);
+        }
+    }
+    arena_release(req);
+    if (retry_max > 0) {
+        finish_request();
+    }
+}
+
+void* resolver(void *outputfd) {
+    outbuf out;
+    request* reqs[RESOLVER_BATCH];
+    char hostname[SBUFSIZE];
+    char result[MAX_RESULT_LENGTH];
+    size_t result_len = 0;
+    unsigned long long start;
+    int status;
+    int home;
+    int n = 0;
+    int h = 0;
+
+    stats_thread_start("resolver");
+    home = __atomic_fetch_add(&next_home, 1, __ATOMIC_RELAXED);
+    if (use_shards) {
+        home %= shards.count;
+    }
+    if (outbuf_init(&out, *(int*)outputfd, 0, output_lock)
+            == OUTBUF_FAILURE) {
+        return NULL;
+    }
+
+    /* Loop Until Queue Is Closed And Drained Or The Pool Shrinks */
+    while (!pool_retire(&resolvers)) {
+        /* Flush Output Before Blocking On An Empty Queue */
+        if ((n = take_requests(home, reqs, RESOLVER_BATCH)) == 0) {
+            outbuf_flush(&out);
+            start = stats_now_ns();
+            n = take_requests_wait(home, reqs, RESOLVER_BATCH);
+            stats_record(STATS_QUEUE_POP, stats_now_ns() - start, 1);
+            if (n == 0) {
+                break;
+            }
+        } else {
+            stats_record(STATS_QUEUE_POP, 0, 0);
+        }
+        for (h = 0; h < n; h++) {
+            memcpy(hostname, reqs[h]->name, reqs[h]->len);
+            hostname[reqs[h]->len] = '\0';
+
+            start = now_ns();
+            status = resolve_name(hostname, reqs[h]->len, result, &result_len);
+            pool_record(&resolvers, now_ns() - start);
+            write_result(&out, reqs[h], status, result, result_len);
+        }
+
+        /* Streams Get Their Results As Soon As They Are Ready */
+        if (daemon_mode) {
+            flush_results(&out);
+        }
+    }
+    outbuf_cleanup(&out);
+    return 0;
+}
+
+/* Start a request: answer it from the cache, park it behind another
+ * thread's lookup, or send it to the engine
+ * Returns 1 if parked, 0 otherwise
+ */
+static int async_start(util_async* engine, outbuf* out, request* req) {
+    char result[MAX_RESULT_LENGTH];
+    size_t result_len = 0;
+    int status = UTIL_SUCCESS;
+    int cached = CACHE_FAILURE;
+
+    if (use_cache) {
+        cached = cache_acquire(&results, req->name, req->len, 0, &status,
+                result, MAX_RESULT_LENGTH, &result_len);
+        if (cached == CACHE_HIT) {
+            neg_hit(status);
+            write_result(out, req, status, result, result_len);
+            return 0;
+        }
+        if (cached == CACHE_PENDING) {
+            return 1;
+        }
+    }
+
+    if (util_async_submit(engine, req->name, req->len, req) == UTIL_SUCCESS) {
+        return 0;
+    }
+
+    /* Not a valid DNS name or the send failed */
+    result_len = format_failure(result);
+    if (cached == CACHE_MISS) {
+        cache_complete(&results, req->name, req->len, UTIL_FAILURE,
+                result, result_len, result_ttl(UTIL_FAILURE));
+    }
+    write_result(out, req, UTIL_FAILURE, result, result_len);
+    return 0;
+}
+
+void* async_resolver(void *outputfd) {
+    outbuf out;
+    util_async engine;
+    util_answer answers[ASYNC_POLL_BATCH];
+    request* reqs[ASYNC_POLL_BATCH];
+    request** parked;
+    char result[MAX_RESULT_LENGTH];
+    size_t result_len;
+    unsigned long long start;
+    int num_parked = 0;
+    int home;
+    int still_parked;
+    int status;
+    int room;
+    int n;
+    int i;
+
+    stats_thread_start("async_resolver");
+    home = __atomic_fetch_add(&next_home, 1, __ATOMIC_RELAXED);
+    if (use_shards) {
+        home %= shards.count;
+    }
+    if (util_async_init(&engine, &backend, max_inflight) == UTIL_FAILURE) {
+        fprintf(stderr, "Error starting async lookups\n");
+        return NULL;
+    }
+    parked = malloc(sizeof(request*) * engine.maxInflight);
+    if (!parked || outbuf_init(&out, *(int*)outputfd, 0, output_lock)
+            == OUTBUF_FAILURE) {
+        free(parked);
+        util_async_cleanup(&engine);
+        return NULL;
+    }
+
+    while (1) {
+        /* Retire Once Nothing Is Left In Flight */
+        if (util_async_inflight(&engine) + num_parked == 0 &&
+                pool_retire(&resolvers)) {
+            break;
+        }
+
+        /* Top Up In-Flight Queries, Blocking Only When Idle */
+        room = engine.maxInflight - util_async_inflight(&engine) - num_parked;
+        while (room > 0) {
+            if (util_async_inflight(&engine) + num_parked == 0) {
+                outbuf_flush(&out);
+                start = stats_now_ns();
+                n = take_requests_wait(home, reqs,
+                        room < ASYNC_POLL_BATCH ? room : ASYNC_POLL_BATCH);
+                stats_record(STATS_QUEUE_POP, stats_now_ns() - start, 1);
+                if (n == 0) {
+                    /* Queue Closed And Drained */
+                    goto done;
+                }
+            } else {
+                n = take_requests(home, reqs,
+                        room < ASYNC_POLL_BATCH ? room : ASYNC_POLL_BATCH);
+                if (n == 0) {
+                    break;
+                }
+                stats_record(STATS_QUEUE_POP, 0, 0);
+            }
+            for (i = 0; i < n; i++) {
+                if (async_start(&engine, &out, reqs[i])) {
+                    parked[num_parked++] = reqs[i];
+                }
+            }
+            room -= n;
+        }
+
+        /* Collect Answers */
+        n = util_async_poll(&engine, answers, ASYNC_POLL_BATCH, ASYNC_POLL_MS);
+        for (i = 0; i < n; i++) {
+            request* req = answers[i].user;
+
+            status = answers[i].status;
+            stats_record(STATS_LOOKUP, answers[i].elapsedMs * 1000000ULL, 0);
+            if (status == UTIL_SUCCESS) {
+                result_len = format_addrs(answers[i].addrs,
+                        answers[i].num_addrs, result);
+            } else {
+                neg_lookup(status, answers[i].elapsedMs * 1000);
+                result_len = format_failure(result);
+            }
+            if (use_cache) {
+                cache_complete(&results, req->name, req->len, status,
+                        result, result_len, result_ttl(status));
+            }
+            write_result(&out, req, status, result, result_len);
+        }
+        if (daemon_mode && n > 0) {
+            flush_results(&out);
+        }
+
+        /* Retry Names Waiting On Other Threads' Lookups */
+        still_parked = 0;
+        for (i = 0; i < num_parked; i++) {
+            if (async_start(&engine, &out, parked[i])) {
+                parked[still_parked++] = parked[i];
+            }
+        }
+        num_parked = still_parked;
+    }
+
+done:
+    outbuf_cleanup(&out);
+    free(parked);
+    util_async_cleanup(&engine);
+    return 0;
+}
+
+/* Pick a resolver count from one interval of queue depth and latency
+ * Busy time over the interval is how many resolvers were kept working;
+ * the backlog adds enough to drain the queue within the next interval.
+ * Async resolvers record no latency, so only occupancy is used for them.
+ */
+static int pool_choose(int current, int depth, unsigned long completed,
+        unsigned long long busy_ns) {
+    unsigned long long interval_ns = POOL_INTERVAL_MS * 1000000ULL;
+    unsigned long long mean_ns;
+    int want;
+
+    if (completed == 0) {
+        if (depth > QUEUEMAXSIZE / 2) {
+            return current * 2;
+        }
+        return depth == 0 ? current - 1 : current;
+    }
+
+    mean_ns = busy_ns / completed;
+    want = (busy_ns + (unsigned long long)depth * mean_ns + interval_ns - 1)
+            / interval_ns;
+
+    /* Grow at once, shrink halfway so one quiet interval is not fatal */
+    if (want < current) {
+        want = current - (current - want + 1) / 2;
+    }
+    return want;
+}
+
+/* Ask the controller for a stats dump, it is not safe to print here */
+static void stats_signal(int sig) {
+    (void) sig;
+    stats_requested = 1;
+}
+
+/* Ask the requesters to stop reading streams and let the rest drain */
+static void stop_signal(int sig) {
+    (void) sig;
+    stop_requested = 1;
+}
+
+/* Resize the resolver pool every interval and report each change */
+static void* controller(void* arg) {
+    unsigned long long busy_ns;
+    unsigned long completed;
+    int current = *(int*)arg;
+    int depth;
+    int next;
+
+    while (!__atomic_load_n(&controller_done, __ATOMIC_ACQUIRE)) {
+        usleep(POOL_INTERVAL_MS * 1000);
+
+        /* Dump Stats Asked For With SIGUSR1 */
+        if (stats_requested) {
+            stats_requested = 0;
+            stats_dump(stdout, stats_json);
+            fflush(stdout);
+        }
+
+        depth = queue_depth();
+        completed = pool_take_stats(&resolvers, &busy_ns);
+        next = pool_choose(current, depth, completed, busy_ns);
+        if (next < resolvers.min) {
+            next = resolvers.min;
+        }
+        if (next > resolvers.max) {
+            next = resolvers.max;
+        }
+        if (next == current) {
+            continue;
+        }
+
+        if (pool_resize(&resolvers, next) == POOL_FAILURE) {
+            continue;
+        }
+        printf("Resolvers: %d -> %d (queue %d, %lu lookups, %llu us mean)\n",
+                current, next, depth, completed,
+                completed ? busy_ns / completed / 1000 : 0);
+        current = next;
+    }
+    return NULL;
+}
 
 int main(int argc, char* argv[]){
 
     /* Local Vars */
-    int num_files = argc -2;
-    int num_requester_threads = num_files;
+    int num_files;
+    int num_requester_threads = sysconf(_SC_NPROCESSORS_ONLN);
     int num_resolver_threads = sysconf(_SC_NPROCESSORS_ONLN); // number of cores
+    int opt;
 
-    pthread_t requester_threads[num_requester_threads];
-    pthread_t resolver_threads[num_resolver_threads];
+    int outputfd = -1;
+    struct stat output_stat;
 
-    FILE* outputfp = NULL;
+    pthread_t controller_thread;
+    struct sigaction sa;
+    int streams = 0;
 
     int t;
     int rc;
 
+    /* Parse Options */
+    while ((opt = getopt(argc, argv, OPTSTRING)) != -1) {
+        switch (opt) {
+        case 'm':
+            use_mmap = 1;
+            break;
+        case 'C':
+            use_cache = 0;
+            break;
+        case 'a':
+            use_async = 1;
+            break;
+        case 'B':
+            binary_output = 1;
+            break;
+        case 'u':
+            use_unique = 1;
+            break;
+        case 'H':
+            use_shards = 1;
+            break;
+        case 'd':
+            daemon_mode = 1;
+            break;
+        case 'w':
+            snapshot_path = optarg;
+            break;
+        case 'o':
+            order_window = strtoul(optarg, NULL, 10);
+            if (order_window < REQUESTER_BATCH) {
+                fprintf(stderr, "Reorder window must be at least %d\n",
+                        REQUESTER_BATCH);
+                return EXIT_FAILURE;
+            }
+            use_order = 1;
+            break;
+        case 'b':
+            backend_spec = optarg;
+            break;
+        case 'q':
+            if (util_profile_parse(&query_profile, optarg) == UTIL_FAILURE) {
+                fprintf(stderr, "Bad query profile: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            use_profile = 1;
+            break;
+        case 'D':
+            deadline_ms = atol(optarg);
+            if (deadline_ms < 1) {
+                fprintf(stderr, "Bad lookup deadline: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            hedge_spec = optarg;
+            break;
+        case 'R':
+            if (sscanf(optarg, "%d:%ld", &retry_max, &retry_base_ms) < 1 ||
+                    retry_max < 0 || retry_max > RESFILE_MAX_RETRIES ||
+                    retry_base_ms < 1) {
+                fprintf(stderr, "Bad retries: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            /* Shorthand For -b dns:server */
+            snprintf(dns_spec, sizeof(dns_spec), "dns:%s", optarg);
+            backend_spec = dns_spec;
+            break;
+        case 'i':
+            max_inflight = atoi(optarg);
+            break;
+        case 'r':
+            num_requester_threads = atoi(optarg);
+            if (num_requester_threads < 1) {
+                fprintf(stderr, "Bad requester count: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            if (sscanf(optarg, "%ld:%ld", &negative[NEG_NOTFOUND].ttlMs,
+                        &negative[NEG_TRANSIENT].ttlMs) != 2 ||
+                    negative[NEG_NOTFOUND].ttlMs < 0 ||
+                    negative[NEG_TRANSIENT].ttlMs < 0) {
+                fprintf(stderr, "Bad negative cache TTLs: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            negative[NEG_NOTFOUND].ttlMs *= 1000;
+            negative[NEG_TRANSIENT].ttlMs *= 1000;
+            break;
+        case 'S':
+            if (strcmp(optarg, "text") && strcmp(optarg, "json")) {
+                fprintf(stderr, "Bad stats format: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            stats_json = strcmp(optarg, "json") == 0;
+            stats_enable();
+            break;
+        case 'p':
+            if (sscanf(optarg, "%d:%d", &pool_min, &pool_max) != 2 ||
+                    pool_min < 1 || pool_max < pool_min) {
+                fprintf(stderr, "Bad resolver pool bounds: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
+            return EXIT_FAILURE;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
     /* Check Arguments */
     if(argc < MINARGS){
         fprintf(stderr, "Not enough arguments: %d\n", (argc - 1));
         fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
         return EXIT_FAILURE;
     }
+    num_files = argc - 2;
+
+    /* The Engine Times Out Its Own Queries */
+    use_hedge = deadline_ms > 0 || hedge_spec;
+    if (use_hedge && use_async) {
+        fprintf(stderr, "Deadlines and hedging (-D, -h) are for blocking "
+                "lookups, not -a\n");
+        return EXIT_FAILURE;
+    }
 
-    /* Check Number of Files */
-    if(num_files > MAX_INPUT_FILES) {
-        fprintf(stderr, "Too many input files: %d\n", num_files);
-        fprintf(stderr, "Max of %d files\n", MAX_INPUT_FILES);
+    /* A Daemon Must Answer A Name Each Time It Is Asked */
+    if (use_unique && daemon_mode) {
+        fprintf(stderr, "Dedupe (-u) cannot be used in daemon mode\n");
         return EXIT_FAILURE;
     }
 
-    /* Check Number of Resolvers */
-    if (num_resolver_threads < MIN_RESOLVER_THREADS) {
-        num_resolver_threads = MIN_RESOLVER_THREADS;
+    /* Start With One Resolver Per Core Within The Pool Bounds */
+    if (num_resolver_threads < pool_min) {
+        num_resolver_threads = pool_min;
+    }
+    if (num_resolver_threads > pool_max) {
+        num_resolver_threads = pool_max;
+    }
+
+    input_file inputs[num_files];
+
+    /* Split Input Into Ranges, No More Requesters Than Ranges */
+    for(t=0; t<num_files; t++){
+        inputs[t].path = argv[t+1];
+        inputs[t].map.data = NULL;
+        inputs[t].map.size = 0;
+    }
+    if (split_inputs(inputs, num_files) < 0) {
+        fprintf(stderr, "Building input work list failed \n");
+        return EXIT_FAILURE;
+    }
+    /* Each Stream Can Hold A Requester, Keep One For Everything Else */
+    for (t = 0; t < num_files; t++) {
+        if (inputs[t].size < 0) {
+            streams++;
+        }
+    }
+    if (num_requester_threads <= streams) {
+        num_requester_threads = streams + 1;
+    }
+    if (num_requester_threads > num_ranges) {
+        num_requester_threads = num_ranges > 0 ? num_ranges : 1;
     }
+    if (use_order) {
+        num_requester_threads = 1;
+    }
+
+    pthread_t requester_threads[num_requester_threads];
 
-    /* Open Output File */
-    outputfp = fopen(argv[(argc-1)], "w");
-    if (!outputfp) {
+    /* Open Output File, "-" Is stdout And Reports Move To stderr */
+    if (strcmp(argv[(argc-1)], "-") == 0) {
+        fflush(stdout);
+        outputfd = dup(STDOUT_FILENO);
+        if (outputfd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "Error opening output file \n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        outputfd = open(argv[(argc-1)], O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+                0666);
+    }
+    if (outputfd < 0) {
         fprintf(stderr, "Error opening output file \n");
         return EXIT_FAILURE;
     }
 
+    /* Binary Results Start With The Format Magic */
+    if (binary_output && resfile_write_magic(outputfd) == RESFILE_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    /* Ordered Output Goes Through One Reorder Buffer */
+    if (use_order && reorder_init(&order, order_window, outputfd)
+            == REORDER_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    /* Appends to a regular file are atomic, anything else needs the lock */
+    if (fstat(outputfd, &output_stat) || !S_ISREG(output_stat.st_mode) ||
+            strcmp(argv[(argc-1)], "-") == 0) {
+        output_lock = &file_lock;
+    }
+
+    /* SIGINT And SIGTERM Stop A Daemon Cleanly */
+    if (daemon_mode) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (sigaction(SIGINT, &sa, NULL) || sigaction(SIGTERM, &sa, NULL)) {
+            perror("Error installing stop signal handler");
+        }
+    }
+
+    /* SIGUSR1 Dumps Stats While Running */
+    if (stats_enabled()) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stats_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (sigaction(SIGUSR1, &sa, NULL)) {
+            perror("Error installing stats signal handler");
+        }
+    }
+
     /* Create the Queue */
-    if (queue_init(&q, QUEUEMAXSIZE) == QUEUE_FAILURE) {
+    if (mpmc_queue_init(&q, QUEUEMAXSIZE) == QUEUE_FAILURE) {
         fprintf(stderr, "Initializing queue failed \n");
         return EXIT_FAILURE;
     }
 
-    /* Init Mutex */
-    if (pthread_mutex_init(&q_lock, NULL)) {
-        fprintf(stderr, "Creating queue mutex failed \n");
+    /* One Shard Per Starting Resolver, Later Ones Share Or Steal */
+    if (use_shards && shard_init(&shards, num_resolver_threads, QUEUEMAXSIZE)
+            == SHARD_FAILURE) {
+        fprintf(stderr, "Initializing shards failed \n");
+        return EXIT_FAILURE;
+    }
+
+    /* Start The Retry Wheel */
+    if (retry_max > 0 && retry_init(&retrier, retry_base_ms, retry_request,
+                NULL) == RETRY_FAILURE) {
+        fprintf(stderr, "Starting retry timer failed \n");
+        return EXIT_FAILURE;
+    }
+
+    /* Create the Result Cache */
+    if (use_cache && cache_init(&results) == CACHE_FAILURE) {
+        fprintf(stderr, "Initializing cache failed \n");
+        return EXIT_FAILURE;
+    }
+
+    /* Create the Set of Names Already Queued */
+    if (use_unique && dedupe_init(&unique) == DEDUPE_FAILURE) {
+        fprintf(stderr, "Initializing dedupe failed \n");
         return EXIT_FAILURE;
     }
+
+    /* A Daemon Keeps Its Cache Warm But Bounded */
+    if (use_cache && daemon_mode) {
+        cache_set_limit(&results, DAEMON_CACHE_ENTRIES);
+    }
+
+    /* Init Mutex */
     if (pthread_mutex_init(&file_lock, NULL)) {
         fprintf(stderr, "Creating file mutex failed \n");
         return EXIT_FAILURE;
     }
-    if (pthread_mutex_init(&finished_lock, NULL)) {
-        fprintf(stderr, "Creating finished mutex failed \n");
+
+    /* Open the Resolver Backend, The DNS Engine by Default for Async */
+    util_backend_register(&adns_backend_ops);
+    if (!backend_spec) {
+        backend_spec = getenv("UTIL_BACKEND");
+    }
+    if (!backend_spec) {
+        backend_spec = use_async ? "dns" : UTIL_DEFAULT_BACKEND;
+    }
+    if (util_backend_open(&backend, backend_spec) == UTIL_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (use_profile) {
+        util_backend_set_profile(&backend, &query_profile);
+    }
+    util_set_backend(&backend);
+
+    /* Lookups On Helpers, Two Per Resolver So Hedges Find One Free */
+    if (hedge_spec) {
+        if (util_backend_open(&hedge_backend, hedge_spec) == UTIL_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        hedge_backend.profile = backend.profile;
+    }
+    if (use_hedge && hedge_init(&hedger, &backend,
+                hedge_spec ? &hedge_backend : NULL, deadline_ms,
+                2 * pool_max) == HEDGE_FAILURE) {
+        fprintf(stderr, "Starting lookup helpers failed \n");
         return EXIT_FAILURE;
     }
 
+    /* Warm Start From A Run With The Same Output, Profile And Backends */
+    if (use_cache && snapshot_path) {
+        if (cache_load(&results, snapshot_path, binary_output,
+                    snapshot_profile(), snapshot_backend(), MAX_RESULT_LENGTH)
+                == CACHE_SUCCESS) {
+            printf("Cache: warm start from %s\n", snapshot_path);
+        } else {
+            printf("Cache: cold start, %s will be written at exit\n",
+                    snapshot_path);
+        }
+    }
+
     /* Spawn Requester Threads */
     for(t=0; t<num_requester_threads; t++){
-        rc = pthread_create(&(requester_threads[t]), NULL, requester, argv[t+1]);
+        rc = pthread_create(&(requester_threads[t]), NULL, requester, NULL);
         if (rc){
             printf("ERROR in input thread creation; return code from pthread_create() is %d\n", rc);
             return EXIT_FAILURE;
         }
     }
 
-    /* Spawn Resolver Threads */
-    for(t=0; t<num_resolver_threads; t++){
-        rc = pthread_create(&(resolver_threads[t]), NULL, resolver,(void*)outputfp);
-        if (rc){
-            printf("ERROR in output thread creation; return code from pthread_create() is %d\n", rc);
-            return EXIT_FAILURE;
-        }
+
+    /* Spawn Resolver Pool And Its Controller */
+    if (pool_init(&resolvers, use_async ? async_resolver : resolver,
+                (void*)&outputfd, pool_min, pool_max) == POOL_FAILURE ||
+            pool_resize(&resolvers, num_resolver_threads) == POOL_FAILURE) {
+        fprintf(stderr, "Creating resolver pool failed \n");
+        return EXIT_FAILURE;
+    }
+    printf("Resolvers: %d (bounds %d:%d)\n", num_resolver_threads,
+            resolvers.min, resolvers.max);
+    rc = pthread_create(&controller_thread, NULL, controller,
+            &num_resolver_threads);
+    if (rc){
+        printf("ERROR in controller thread creation; return code from pthread_create() is %d\n", rc);
+        return EXIT_FAILURE;
     }
 
     /* Wait For Requester Threads */
@@ -211,34 +1480,92 @@ int main(int argc, char* argv[]){
         pthread_join(requester_threads[t],NULL);
     }
 
+    /* Retries Need The Queue Until Every Name Is Written */
+    if (retry_max > 0) {
+        pthread_mutex_lock(&drain_lock);
+        while (__atomic_load_n(&outstanding, __ATOMIC_ACQUIRE) > 0) {
+            pthread_cond_wait(&drained, &drain_lock);
+        }
+        pthread_mutex_unlock(&drain_lock);
+        retry_report(&retrier, stdout);
+        retry_cleanup(&retrier);
+    }
+
     /* Let The Resolvers Know Requesters are done */
-    pthread_mutex_lock(&finished_lock);
-    requesters_finished = 1;
-    pthread_mutex_unlock(&finished_lock);
+    mpmc_queue_close(&q);
+    if (use_shards) {
+        shard_close(&shards);
+    }
+
+    /* Wait for Resolver Threads, Still Resizing While They Drain */
+    pool_join(&resolvers);
+    __atomic_store_n(&controller_done, 1, __ATOMIC_RELEASE);
+    pthread_join(controller_thread, NULL);
+    printf("Resolvers: peak %d\n", resolvers.peak);
+    pool_cleanup(&resolvers);
 
-    /* Wait for Resolver Threads */
-    for(t=0; t<num_resolver_threads; t++){
-        pthread_join(resolver_threads[t],NULL);
+    /* A Helper Stuck In An Abandoned Lookup Still Uses Its Backend */
+    if (use_hedge) {
+        hedge_report(&hedger, stdout);
+    }
+    if (!use_hedge || hedge_cleanup(&hedger) == HEDGE_SUCCESS) {
+        if (hedge_spec) {
+            util_backend_close(&hedge_backend);
+        }
+        util_backend_close(&backend);
+    }
+
+    /* Report Lookup Stage Stats */
+    if (stats_enabled()) {
+        stats_dump(stdout, stats_json);
+        stats_cleanup();
+    }
+
+    /* Write Out The Last Ordered Lines */
+    if (use_order) {
+        reorder_report(&order, stdout);
+        reorder_cleanup(&order);
     }
 
     /* Close Output File */
-    if (fclose(outputfp)) {
+    if (close(outputfd)) {
         fprintf(stderr, "Error closing output file \n");
     }
 
-    /* Cleanup Queue */
-    queue_cleanup(&q);
+    /* Cleanup Queue and Input Mappings */
+    mpmc_queue_cleanup(&q);
+    if (use_shards) {
+        shard_report(&shards, stdout);
+        shard_cleanup(&shards);
+    }
+    for(t=0; t<num_files; t++){
+        scan_unmap_file(&inputs[t].map);
+    }
+    free(ranges);
+
+    /* Report and Cleanup Dedupe */
+    if (use_unique) {
+        dedupe_report(&unique, stdout);
+        printf("Dedupe: %lu invalid names dropped\n", invalid_names);
+        dedupe_cleanup(&unique);
+    }
+
+    /* Report and Cleanup Cache */
+    if (use_cache) {
+        if (snapshot_path &&
+                cache_save(&results, snapshot_path, binary_output,
+                    snapshot_profile(), snapshot_backend()) == CACHE_FAILURE) {
+            fprintf(stderr, "Saving cache snapshot failed \n");
+        }
+        cache_report(&results, stdout);
+        neg_report(stdout);
+        cache_cleanup(&results);
+    }
 
     /* Destroy Mutex */
-    if (pthread_mutex_destroy(&q_lock)) {
-        fprintf(stderr, "Destroying queue mutex failed \n");
-    } 
     if (pthread_mutex_destroy(&file_lock)) {
         fprintf(stderr, "Destroying file mutex failed \n");
     }
-    if (pthread_mutex_destroy(&finished_lock)) {
-        fprintf(stderr, "Destroying finished mutex failed \n");
-    }
 
     printf("All of the threads were completed!\n");
     return EXIT_SUCCESS;
@@ -1,8 +1,66 @@
-#define MAX_INPUT_FILES 10
+#include "scan.h"
+
 #define MAX_RESOLVER_THREADS 10
 #define MIN_RESOLVER_THREADS 2
 #define MAX_NAME_LENGTH 2015
 #define MAX_IP_LENGTH INET6_ADDRSTRLEN
+#define MAX_RESULT_LENGTH (UTIL_MAX_ADDRS * MAX_IP_LENGTH + 1)
+#define REQUESTER_BATCH 32
+#define RESOLVER_BATCH 4
+#define ASYNC_POLL_BATCH 64
+#define ASYNC_POLL_MS 10
+#define POOL_INTERVAL_MS 100
+#define INPUT_SHARD_BYTES (1 << 20)
+#define PIPE_BUFFER_SIZE (64 * 1024)
+#define PIPE_POLL_MS 100
+#define DAEMON_CACHE_ENTRIES (1 << 20)
+#define NEG_NOTFOUND_TTL_MS (300 * 1000)
+#define NEG_TRANSIENT_TTL_MS (30 * 1000)
+
+/* Error classes of the negative cache */
+#define NEG_NOTFOUND 0
+#define NEG_TRANSIENT 1
+#define NEG_CLASSES 2
+
+/* One hostname handed from a requester to a resolver
+ * name is not NUL terminated; it may point into a mapped input file
+ * seq is its place in the input, used only for ordered output
+ * attempts counts retries after transient failures
+ */
+typedef struct request_s{
+    const char* name;
+    size_t len;
+    unsigned long seq;
+    int attempts;
+} request;
+
+/* One input file, its size (-1 if unknown) and, in mmap mode,
+ * its mapping
+ */
+typedef struct input_file_s{
+    char* path;
+    off_t size;
+    scan_map map;
+} input_file;
+
+/* A byte range of one input file, the unit of work for a requester
+ * Ranges of a split file start and end on whitespace so no name is
+ * cut in two; end is -1 for a file read to EOF
+ */
+typedef struct input_range_s{
+    input_file* input;
+    off_t start;
+    off_t end;
+} input_range;
+
+/* Failed lookups of one error class and cache hits that skipped them */
+typedef struct neg_stats_s{
+    long ttlMs;
+    unsigned long lookups;
+    unsigned long long lookupUs;
+    unsigned long hits;
+} neg_stats;
 
-void* requester(void* filename);
-void* resolver(void* outputfp);
+void* requester(void* arg);
+void* resolver(void* outputfd);
+void* async_resolver(void* outputfd);
@@ -0,0 +1,90 @@
+/*
+ * File: outbuf.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a per-thread output
+ *      buffer flushed with one write() per batch of lines.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+#include "stats.h"
+
+int outbuf_init(outbuf* b, int fd, size_t cap, pthread_mutex_t* lock){
+    b->fd = fd;
+    b->lock = lock;
+    b->len = 0;
+    b->cap = cap ? cap : OUTBUF_DEFAULT_SIZE;
+    b->data = malloc(b->cap);
+    if(!b->data){
+	perror("Error on output buffer Malloc");
+	return OUTBUF_FAILURE;
+    }
+
+    return OUTBUF_SUCCESS;
+}
+
+char* outbuf_reserve(outbuf* b, size_t maxLen){
+    if(maxLen > b->cap){
+	return NULL;
+    }
+    if(b->len + maxLen > b->cap && outbuf_flush(b) == OUTBUF_FAILURE){
+	return NULL;
+    }
+
+    return b->data + b->len;
+}
+
+void outbuf_commit(outbuf* b, size_t len){
+    b->len += len;
+}
+
+int outbuf_flush(outbuf* b){
+    unsigned long long start;
+    size_t done = 0;
+    ssize_t n;
+    int ret = OUTBUF_SUCCESS;
+
+    if(b->len == 0){
+	return OUTBUF_SUCCESS;
+    }
+
+    if(b->lock){
+	stats_lock(b->lock, STATS_OUTPUT_LOCK);
+    }
+    /* only a short write on error splits the batch */
+    start = stats_enabled() ? stats_now_ns() : 0;
+    while(done < b->len){
+	n = write(b->fd, b->data + done, b->len - done);
+	if(n < 0){
+	    if(errno == EINTR){
+		continue;
+	    }
+	    perror("Error writing output");
+	    ret = OUTBUF_FAILURE;
+	    break;
+	}
+	done += n;
+    }
+    if(start){
+	stats_record(STATS_OUTPUT_WRITE, stats_now_ns() - start, 0);
+    }
+    if(b->lock){
+	pthread_mutex_unlock(b->lock);
+    }
+
+    b->len = 0;
+    return ret;
+}
+
+void outbuf_cleanup(outbuf* b){
+    outbuf_flush(b);
+    free(b->data);
+    b->data = NULL;
+}
@@ -0,0 +1,57 @@
+/*
+ * File: outbuf.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a per-thread output buffer. Each
+ *      thread formats whole lines into its own buffer and flushes them
+ *      with a single write(), so lines from different threads never
+ *      interleave as long as the descriptor is a regular file opened
+ *      with O_APPEND. Other descriptors pass a lock that is held only
+ *      for the flush.
+ *
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define OUTBUF_FAILURE -1
+#define OUTBUF_SUCCESS 0
+
+#define OUTBUF_DEFAULT_SIZE (256 * 1024)
+
+typedef struct outbuf_s{
+    int fd;
+    pthread_mutex_t* lock;
+    char* data;
+    size_t len;
+    size_t cap;
+} outbuf;
+
+/* Function to initilze a buffer writing to fd
+ * lock may be NULL when fd is a regular file opened with O_APPEND
+ * Returns OUTBUF_SUCCESS or OUTBUF_FAILURE
+ */
+int outbuf_init(outbuf* b, int fd, size_t cap, pthread_mutex_t* lock);
+
+/* Function to get room for a line of up to maxLen bytes
+ * Flushes first if the line might not fit
+ * Returns NULL if maxLen is larger than the buffer or the flush failed
+ */
+char* outbuf_reserve(outbuf* b, size_t maxLen);
+
+/* Function to keep len bytes written at the last reserve */
+void outbuf_commit(outbuf* b, size_t len);
+
+/* Function to write out everything buffered
+ * Returns OUTBUF_SUCCESS or OUTBUF_FAILURE
+ */
+int outbuf_flush(outbuf* b);
+
+/* Function to flush and free the buffer */
+void outbuf_cleanup(outbuf* b);
+
+#endif
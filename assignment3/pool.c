@@ -0,0 +1,125 @@
+/*
+ * File: pool.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a resizable pool of
+ *      detached worker threads.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pool.h"
+
+/* Runs one worker and accounts for its exit */
+static void* pool_thread(void* arg){
+    pool* p = arg;
+
+    p->worker(p->arg);
+
+    pthread_mutex_lock(&p->lock);
+    p->running--;
+    pthread_cond_broadcast(&p->exited);
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+int pool_init(pool* p, void* (*worker)(void*), void* arg, int min, int max){
+    p->worker = worker;
+    p->arg = arg;
+    p->min = min > 0 ? min : 1;
+    p->max = max > p->min ? max : p->min;
+    p->target = 0;
+    p->active = 0;
+    p->running = 0;
+    p->closing = 0;
+    p->peak = 0;
+    p->busyNs = 0;
+    p->completed = 0;
+
+    if(pthread_mutex_init(&p->lock, NULL) ||
+       pthread_cond_init(&p->exited, NULL)){
+	fprintf(stderr, "Error on pool mutex setup\n");
+	return POOL_FAILURE;
+    }
+
+    return POOL_SUCCESS;
+}
+
+int pool_resize(pool* p, int target){
+    pthread_t thread;
+    int rc = 0;
+
+    if(target < p->min){
+	target = p->min;
+    }
+    if(target > p->max){
+	target = p->max;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->target = target;
+    while(!p->closing && p->active < p->target){
+	rc = pthread_create(&thread, NULL, pool_thread, p);
+	if(rc){
+	    fprintf(stderr, "ERROR in pool thread creation; "
+		    "return code from pthread_create() is %d\n", rc);
+	    break;
+	}
+	pthread_detach(thread);
+	p->active++;
+	p->running++;
+    }
+    if(p->active > p->peak){
+	p->peak = p->active;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return rc ? POOL_FAILURE : target;
+}
+
+int pool_retire(pool* p){
+    int retire = 0;
+
+    /* cheap check first, the lock only when shrinking */
+    if(__atomic_load_n(&p->active, __ATOMIC_RELAXED) <=
+       __atomic_load_n(&p->target, __ATOMIC_RELAXED)){
+	return 0;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if(p->active > p->target){
+	p->active--;
+	retire = 1;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return retire;
+}
+
+void pool_record(pool* p, unsigned long long ns){
+    __atomic_add_fetch(&p->busyNs, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p->completed, 1, __ATOMIC_RELAXED);
+}
+
+unsigned long pool_take_stats(pool* p, unsigned long long* busyNs){
+    *busyNs = __atomic_exchange_n(&p->busyNs, 0, __ATOMIC_RELAXED);
+    return __atomic_exchange_n(&p->completed, 0, __ATOMIC_RELAXED);
+}
+
+void pool_join(pool* p){
+    pthread_mutex_lock(&p->lock);
+    p->closing = 1;
+    while(p->running > 0){
+	pthread_cond_wait(&p->exited, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_cleanup(pool* p){
+    pthread_cond_destroy(&p->exited);
+    pthread_mutex_destroy(&p->lock);
+}
@@ -0,0 +1,68 @@
+/*
+ * File: pool.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a resizable pool of worker threads.
+ *      Growing spawns threads right away; shrinking lowers the target
+ *      and workers retire themselves when they next call pool_retire.
+ *      Workers report how long each unit of work took so a controller
+ *      can size the pool from observed latency.
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+#define POOL_FAILURE -1
+#define POOL_SUCCESS 0
+
+typedef struct pool_s{
+    void* (*worker)(void*);
+    void* arg;
+    int min;
+    int max;
+    int target;
+    int active;
+    int running;
+    int closing;
+    int peak;
+    pthread_mutex_t lock;
+    pthread_cond_t exited;
+    unsigned long long busyNs;
+    unsigned long completed;
+} pool;
+
+/* Function to initilze an empty pool of worker(arg) threads
+ * Returns POOL_SUCCESS or POOL_FAILURE
+ */
+int pool_init(pool* p, void* (*worker)(void*), void* arg, int min, int max);
+
+/* Function to set the number of workers, clamped to [min, max]
+ * Spawns threads to grow; extra threads retire on their own
+ * Returns the new target or POOL_FAILURE if a thread could not start
+ */
+int pool_resize(pool* p, int target);
+
+/* Function for a worker to ask whether it should exit
+ * Returns 1 if the worker has been retired, 0 otherwise
+ */
+int pool_retire(pool* p);
+
+/* Function for a worker to record one unit of work */
+void pool_record(pool* p, unsigned long long ns);
+
+/* Function to take and reset the recorded work
+ * Returns the number of units since the last call
+ */
+unsigned long pool_take_stats(pool* p, unsigned long long* busyNs);
+
+/* Function to stop growing and wait for every worker to exit */
+void pool_join(pool* p);
+
+/* Function to free pool resources after pool_join */
+void pool_cleanup(pool* p);
+
+#endif
@@ -0,0 +1,504 @@
+/*
+ * File: queueBench.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains a stress test and throughput benchmark for the
+ *      queues. Every queue runs with each count of producers and
+ *      consumers at each capacity; each run prints items/sec, push and
+ *      pop latency percentiles and any items lost or seen twice. The
+ *      exit status is nonzero if any run lost or duplicated an item.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "queue.h"
+#include "mpmcqueue.h"
+
+#define USAGE "[-n items] [-p producers,...] [-c consumers,...] [-s capacities,...] [-q queues,...]"
+#define OPTSTRING "n:p:c:s:q:"
+
+#define QB_ITEMS 200000
+#define QB_PRODUCERS "1,2,4,8"
+#define QB_CONSUMERS "1,2,4,8"
+#define QB_CAPACITIES "16,1024"
+#define QB_QUEUES "locked,mpmc,mpmc-batch"
+#define QB_MAX_THREADS 64
+#define QB_MAX_LIST 16
+#define QB_BATCH 8
+#define QB_MAX_SAMPLES 16384
+#define QB_LIST 256
+
+/* One queue under test
+ * push blocks until all n are pushed and returns how many were
+ * pop blocks for at least one and returns 0 once closed and drained
+ */
+typedef struct qb_ops_s{
+    const char* name;
+    int batch;
+    void* (*init)(int capacity);
+    int (*push)(void* q, void** items, int n);
+    int (*pop)(void* q, void** items, int n);
+    void (*close)(void* q);
+    void (*cleanup)(void* q);
+} qb_ops;
+
+/* One thread's share of a run and the latencies it sampled */
+typedef struct qb_thread_s{
+    const qb_ops* ops;
+    void* q;
+    long first;
+    long count;
+    unsigned int* seen;
+    unsigned int* samples;
+    unsigned long num_samples;
+    long stride;
+    pthread_t thread;
+} qb_thread;
+
+/* queue.c behind a mutex and two condition variables, the way
+ * lookups were handed off before mpmcqueue
+ */
+typedef struct qb_locked_s{
+    queue q;
+    pthread_mutex_t lock;
+    pthread_cond_t notFull;
+    pthread_cond_t notEmpty;
+    int closed;
+} qb_locked;
+
+static void* qb_locked_init(int capacity){
+    qb_locked* l = malloc(sizeof(qb_locked));
+
+    if(!l || queue_init(&l->q, capacity) == QUEUE_FAILURE){
+	free(l);
+	return NULL;
+    }
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->notFull, NULL);
+    pthread_cond_init(&l->notEmpty, NULL);
+    l->closed = 0;
+    return l;
+}
+
+static int qb_locked_push(void* q, void** items, int n){
+    qb_locked* l = q;
+    int i;
+
+    pthread_mutex_lock(&l->lock);
+    for(i=0; i<n; i++){
+	while(queue_is_full(&l->q)){
+	    pthread_cond_wait(&l->notFull, &l->lock);
+	}
+	queue_push(&l->q, items[i]);
+	pthread_cond_signal(&l->notEmpty);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return n;
+}
+
+static int qb_locked_pop(void* q, void** items, int n){
+    qb_locked* l = q;
+    int got = 0;
+
+    pthread_mutex_lock(&l->lock);
+    while(queue_is_empty(&l->q) && !l->closed){
+	pthread_cond_wait(&l->notEmpty, &l->lock);
+    }
+    while(got < n && !queue_is_empty(&l->q)){
+	items[got++] = queue_pop(&l->q);
+	pthread_cond_signal(&l->notFull);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return got;
+}
+
+static void qb_locked_close(void* q){
+    qb_locked* l = q;
+
+    pthread_mutex_lock(&l->lock);
+    l->closed = 1;
+    pthread_cond_broadcast(&l->notEmpty);
+    pthread_mutex_unlock(&l->lock);
+}
+
+static void qb_locked_cleanup(void* q){
+    qb_locked* l = q;
+
+    queue_cleanup(&l->q);
+    pthread_cond_destroy(&l->notFull);
+    pthread_cond_destroy(&l->notEmpty);
+    pthread_mutex_destroy(&l->lock);
+    free(l);
+}
+
+static void* qb_mpmc_init(int capacity){
+    mpmc_queue* m = malloc(sizeof(mpmc_queue));
+
+    if(!m || mpmc_queue_init(m, capacity) == QUEUE_FAILURE){
+	free(m);
+	return NULL;
+    }
+    return m;
+}
+
+static int qb_mpmc_push(void* q, void** items, int n){
+    if(n == 1){
+	return mpmc_queue_push_wait(q, items[0]) == QUEUE_SUCCESS;
+    }
+    return mpmc_queue_push_n_wait(q, items, n);
+}
+
+static int qb_mpmc_pop(void* q, void** items, int n){
+    if(n == 1){
+	return (items[0] = mpmc_queue_pop_wait(q)) != NULL;
+    }
+    return mpmc_queue_pop_n_wait(q, items, n);
+}
+
+static void qb_mpmc_close(void* q){
+    mpmc_queue_close(q);
+}
+
+static void qb_mpmc_cleanup(void* q){
+    mpmc_queue_cleanup(q);
+    free(q);
+}
+
+static const qb_ops qb_queues[] = {
+    { "locked", 1, qb_locked_init, qb_locked_push, qb_locked_pop,
+      qb_locked_close, qb_locked_cleanup },
+    { "mpmc", 1, qb_mpmc_init, qb_mpmc_push, qb_mpmc_pop,
+      qb_mpmc_close, qb_mpmc_cleanup },
+    { "mpmc-batch", QB_BATCH, qb_mpmc_init, qb_mpmc_push, qb_mpmc_pop,
+      qb_mpmc_close, qb_mpmc_cleanup },
+};
+
+static long long qb_now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void qb_sample(qb_thread* t, long op, long long ns){
+    if(op % t->stride == 0 && t->num_samples < QB_MAX_SAMPLES){
+	t->samples[t->num_samples++] = ns;
+    }
+}
+
+/* Push items first..first+count, numbered from 1 so none is NULL */
+static void* qb_producer(void* arg){
+    qb_thread* t = arg;
+    void* items[QB_BATCH];
+    long long start;
+    long next = t->first;
+    long end = t->first + t->count;
+    long op = 0;
+    int n;
+    int i;
+
+    while(next < end){
+	n = end - next < t->ops->batch ? end - next : t->ops->batch;
+	for(i=0; i<n; i++){
+	    items[i] = (void*)(next + i + 1);
+	}
+	start = qb_now_ns();
+	if(t->ops->push(t->q, items, n) != n){
+	    fprintf(stderr, "%s push failed\n", t->ops->name);
+	    break;
+	}
+	qb_sample(t, op++, qb_now_ns() - start);
+	next += n;
+    }
+    return NULL;
+}
+
+/* Pop until closed and drained, counting each item seen */
+static void* qb_consumer(void* arg){
+    qb_thread* t = arg;
+    void* items[QB_BATCH];
+    long long start;
+    long op = 0;
+    int n;
+    int i;
+
+    while(1){
+	start = qb_now_ns();
+	n = t->ops->pop(t->q, items, t->ops->batch);
+	if(n == 0){
+	    break;
+	}
+	qb_sample(t, op++, qb_now_ns() - start);
+	for(i=0; i<n; i++){
+	    __atomic_add_fetch(&t->seen[(long)items[i] - 1], 1,
+			       __ATOMIC_RELAXED);
+	}
+	t->count += n;
+    }
+    return NULL;
+}
+
+static int qb_compare(const void* a, const void* b){
+    unsigned int x = *(const unsigned int*)a;
+    unsigned int y = *(const unsigned int*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Gather the samples of threads, sorted
+ * Returns the number of samples, 0 on failure
+ */
+static unsigned long qb_gather(qb_thread* threads, int n,
+			       unsigned int** out){
+    unsigned long total = 0;
+    int i;
+
+    for(i=0; i<n; i++){
+	total += threads[i].num_samples;
+    }
+    *out = malloc(sizeof(unsigned int) * (total ? total : 1));
+    if(!*out){
+	return 0;
+    }
+    total = 0;
+    for(i=0; i<n; i++){
+	memcpy(*out + total, threads[i].samples,
+	       sizeof(unsigned int) * threads[i].num_samples);
+	total += threads[i].num_samples;
+    }
+    qsort(*out, total, sizeof(unsigned int), qb_compare);
+    return total;
+}
+
+static unsigned int qb_percentile(const unsigned int* s, unsigned long n,
+				  int perMille){
+    return n ? s[n * perMille / 1000] : 0;
+}
+
+/* Run items through one queue with producers and consumers
+ * Returns the number of items lost or duplicated, -1 on failure
+ */
+static long qb_run(const qb_ops* ops, int producers, int consumers,
+		   int capacity, long items){
+    qb_thread threads[QB_MAX_THREADS * 2];
+    unsigned int* seen;
+    unsigned int* pushes;
+    unsigned int* pops;
+    unsigned long num_pushes;
+    unsigned long num_pops;
+    long long start;
+    double wallSec;
+    long lost = 0;
+    long dup = 0;
+    long i;
+    int total = producers + consumers;
+    int t;
+    void* q;
+
+    q = ops->init(capacity);
+    seen = calloc(items, sizeof(unsigned int));
+    if(!q || !seen){
+	fprintf(stderr, "Error creating %s queue of %d\n", ops->name, capacity);
+	if(q){
+	    ops->cleanup(q);
+	}
+	free(seen);
+	return -1;
+    }
+
+    for(t=0; t<total; t++){
+	threads[t].ops = ops;
+	threads[t].q = q;
+	threads[t].seen = seen;
+	threads[t].num_samples = 0;
+	if(t < producers){
+	    threads[t].first = items / producers * t;
+	    threads[t].count = t == producers - 1 ?
+		items - threads[t].first : items / producers;
+	    threads[t].stride = threads[t].count / ops->batch /
+		QB_MAX_SAMPLES + 1;
+	}
+	else{
+	    threads[t].first = 0;
+	    threads[t].count = 0;
+	    threads[t].stride = items / consumers / ops->batch /
+		QB_MAX_SAMPLES + 1;
+	}
+	threads[t].samples = malloc(sizeof(unsigned int) * QB_MAX_SAMPLES);
+	if(!threads[t].samples){
+	    perror("Error on queueBench Malloc");
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    /* Consumers First So Producers Never Start Against No One */
+    start = qb_now_ns();
+    for(t=total-1; t>=0; t--){
+	if(pthread_create(&threads[t].thread, NULL,
+			  t < producers ? qb_producer : qb_consumer,
+			  &threads[t])){
+	    fprintf(stderr, "Error creating queueBench thread\n");
+	    exit(EXIT_FAILURE);
+	}
+    }
+    for(t=0; t<producers; t++){
+	pthread_join(threads[t].thread, NULL);
+    }
+    ops->close(q);
+    for(t=producers; t<total; t++){
+	pthread_join(threads[t].thread, NULL);
+    }
+    wallSec = (qb_now_ns() - start) / 1e9;
+
+    /* Every Item Exactly Once */
+    for(i=0; i<items; i++){
+	if(seen[i] == 0){
+	    lost++;
+	}
+	else if(seen[i] > 1){
+	    dup += seen[i] - 1;
+	}
+    }
+
+    num_pushes = qb_gather(threads, producers, &pushes);
+    num_pops = qb_gather(threads + producers, consumers, &pops);
+    printf("%-10s %4d %4d %6d %10.0f %7u %7u %7u %7u %7u %7u %5ld %5ld\n",
+	   ops->name, producers, consumers, capacity, items / wallSec,
+	   qb_percentile(pushes, num_pushes, 500),
+	   qb_percentile(pushes, num_pushes, 990),
+	   qb_percentile(pushes, num_pushes, 999),
+	   qb_percentile(pops, num_pops, 500),
+	   qb_percentile(pops, num_pops, 990),
+	   qb_percentile(pops, num_pops, 999), lost, dup);
+    fflush(stdout);
+
+    free(pushes);
+    free(pops);
+    for(t=0; t<total; t++){
+	free(threads[t].samples);
+    }
+    free(seen);
+    ops->cleanup(q);
+
+    return lost + dup;
+}
+
+/* Parse a comma separated list of counts from 1 to max
+ * Returns the number parsed, 0 on a bad list
+ */
+static int qb_parse_list(const char* arg, int* out, int max){
+    char list[QB_LIST];
+    char* token;
+    char* save;
+    int n = 0;
+
+    snprintf(list, sizeof(list), "%s", arg);
+    for(token = strtok_r(list, ",", &save); token;
+	token = strtok_r(NULL, ",", &save)){
+	if(n == QB_MAX_LIST || (out[n] = atoi(token)) < 1 || out[n] > max){
+	    return 0;
+	}
+	n++;
+    }
+    return n;
+}
+
+int main(int argc, char* argv[]){
+
+    const char* producerList = QB_PRODUCERS;
+    const char* consumerList = QB_CONSUMERS;
+    const char* capacityList = QB_CAPACITIES;
+    char queueList[QB_LIST] = QB_QUEUES;
+    const qb_ops* ops;
+    int producers[QB_MAX_LIST];
+    int consumers[QB_MAX_LIST];
+    int capacities[QB_MAX_LIST];
+    int num_producers;
+    int num_consumers;
+    int num_capacities;
+    long items = QB_ITEMS;
+    long bad;
+    char* token;
+    char* save;
+    int rc = EXIT_SUCCESS;
+    int opt;
+    int p;
+    int c;
+    int s;
+    size_t i;
+
+    while((opt = getopt(argc, argv, OPTSTRING)) != -1){
+	switch(opt){
+	case 'n':
+	    items = atol(optarg);
+	    break;
+	case 'p':
+	    producerList = optarg;
+	    break;
+	case 'c':
+	    consumerList = optarg;
+	    break;
+	case 's':
+	    capacityList = optarg;
+	    break;
+	case 'q':
+	    snprintf(queueList, sizeof(queueList), "%s", optarg);
+	    break;
+	default:
+	    fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
+	    return EXIT_FAILURE;
+	}
+    }
+    num_producers = qb_parse_list(producerList, producers, QB_MAX_THREADS);
+    num_consumers = qb_parse_list(consumerList, consumers, QB_MAX_THREADS);
+    num_capacities = qb_parse_list(capacityList, capacities, 1 << 24);
+    if(items < 1 || !num_producers || !num_consumers || !num_capacities){
+	fprintf(stderr, "Need at least one item and 1 to %d threads\n",
+		QB_MAX_THREADS);
+	fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
+	return EXIT_FAILURE;
+    }
+
+    printf("%ld items per run, latencies in ns per call, batches of %d "
+	   "for mpmc-batch\n", items, QB_BATCH);
+    printf("%-10s %4s %4s %6s %10s %7s %7s %7s %7s %7s %7s %5s %5s\n",
+	   "queue", "prod", "cons", "cap", "items/s", "push50", "push99",
+	   "push999", "pop50", "pop99", "pop999", "lost", "dup");
+
+    for(token = strtok_r(queueList, ",", &save); token;
+	token = strtok_r(NULL, ",", &save)){
+	ops = NULL;
+	for(i=0; i<sizeof(qb_queues) / sizeof(qb_queues[0]); i++){
+	    if(strcmp(token, qb_queues[i].name) == 0){
+		ops = &qb_queues[i];
+	    }
+	}
+	if(!ops){
+	    fprintf(stderr, "Unknown queue: %s\n", token);
+	    rc = EXIT_FAILURE;
+	    continue;
+	}
+
+	for(s=0; s<num_capacities; s++){
+	    for(p=0; p<num_producers; p++){
+		for(c=0; c<num_consumers; c++){
+		    bad = qb_run(ops, producers[p], consumers[c],
+				 capacities[s], items);
+		    if(bad != 0){
+			rc = EXIT_FAILURE;
+		    }
+		}
+	    }
+	}
+    }
+
+    return rc;
+}
@@ -14,10 +14,285 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "queue.h"
+#include "mpmcqueue.h"
 
 #define TEST_SIZE 10
+#define MPMC_TEST_SIZE 16
+#define MPMC_THREADS 4
+#define MPMC_ITEMS 100000
+#define MPMC_PUSH_BATCH 7
+#define MPMC_POP_BATCH 5
+
+mpmc_queue mq;
+long mpmc_sum = 0;
+
+void* mpmc_producer(void* arg){
+    long base = (long)arg;
+    long i;
+
+    for(i=1; i<=MPMC_ITEMS; i++){
+	while(mpmc_queue_push(&mq, (void*)(base + i)) == QUEUE_FAILURE){
+	    sched_yield();
+	}
+    }
+    return NULL;
+}
+
+void* mpmc_consumer(void* arg){
+    long sum = 0;
+    long n = 0;
+    void* payload;
+
+    (void) arg;
+
+    while(n < MPMC_ITEMS){
+	if((payload = mpmc_queue_pop(&mq)) == NULL){
+	    sched_yield();
+	    continue;
+	}
+	sum += (long)payload;
+	n++;
+    }
+    __atomic_add_fetch(&mpmc_sum, sum, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+void* mpmc_wait_producer(void* arg){
+    long base = (long)arg;
+    long i;
+
+    for(i=1; i<=MPMC_ITEMS; i++){
+	if(mpmc_queue_push_wait(&mq, (void*)(base + i)) == QUEUE_FAILURE){
+	    fprintf(stderr,
+		    "error: mpmc_queue_push_wait failed while open!\n");
+	}
+    }
+    return NULL;
+}
+
+void* mpmc_wait_consumer(void* arg){
+    long sum = 0;
+    void* payload;
+
+    (void) arg;
+
+    while((payload = mpmc_queue_pop_wait(&mq)) != NULL){
+	sum += (long)payload;
+    }
+    __atomic_add_fetch(&mpmc_sum, sum, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+void* mpmc_batch_producer(void* arg){
+    long base = (long)arg;
+    long i;
+    int j;
+    void* batch[MPMC_PUSH_BATCH];
+
+    for(i=1; i<=MPMC_ITEMS; ){
+	for(j=0; j<MPMC_PUSH_BATCH && i<=MPMC_ITEMS; j++, i++){
+	    batch[j] = (void*)(base + i);
+	}
+	if(mpmc_queue_push_n_wait(&mq, batch, j) != j){
+	    fprintf(stderr,
+		    "error: mpmc_queue_push_n_wait short while open!\n");
+	}
+    }
+    return NULL;
+}
+
+void* mpmc_batch_consumer(void* arg){
+    long sum = 0;
+    int n;
+    int j;
+    void* batch[MPMC_POP_BATCH];
+
+    (void) arg;
+
+    while((n = mpmc_queue_pop_n_wait(&mq, batch, MPMC_POP_BATCH)) > 0){
+	for(j=0; j<n; j++){
+	    sum += (long)batch[j];
+	}
+    }
+    __atomic_add_fetch(&mpmc_sum, sum, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/* Runs the single threaded FIFO checks and a
+ * threaded producer/consumer check against mpmcqueue */
+int test_mpmc_queue(int** payload_in){
+
+    int i;
+    int qSize;
+    int errors = 0;
+    long expected = 0;
+    int* payload_out[MPMC_TEST_SIZE];
+    pthread_t producers[MPMC_THREADS];
+    pthread_t consumers[MPMC_THREADS];
+
+    /* Initialize Queue */
+    if((qSize = mpmc_queue_init(&mq, MPMC_TEST_SIZE - 1))
+       != MPMC_TEST_SIZE){
+	fprintf(stderr,
+		"error: mpmc_queue_init did not round to %d!\n",
+		MPMC_TEST_SIZE);
+	return 1;
+    }
+
+    /* Test for empty queue when empty */
+    if(!mpmc_queue_is_empty(&mq) || mpmc_queue_is_full(&mq)){
+	fprintf(stderr,
+		"error: mpmc queue should report empty\n");
+	errors++;
+    }
+
+    /* Test queue push */
+    for(i=0; i<qSize; i++){
+	if(mpmc_queue_push(&mq, payload_in[i % TEST_SIZE])
+	   == QUEUE_FAILURE){
+	    fprintf(stderr,
+		    "error: mpmc_queue_push failed!\n"
+		    "Payload Index: %d\n", i);
+	    errors++;
+	}
+    }
+
+    /* Test for full queue when full */
+    if(mpmc_queue_is_empty(&mq) || !mpmc_queue_is_full(&mq)){
+	fprintf(stderr,
+		"error: mpmc queue should report full\n");
+	errors++;
+    }
+
+    /* Test that push fails when full */
+    if(mpmc_queue_push(&mq, payload_in[0]) != QUEUE_FAILURE){
+	fprintf(stderr,
+		"error: mpmc_queue_push did not fail"
+		" when full!\n");
+	errors++;
+    }
+
+    /* Test queue pop and compare */
+    for(i=0; i<qSize; i++){
+	payload_out[i] = mpmc_queue_pop(&mq);
+	if(payload_out[i] != payload_in[i % TEST_SIZE]){
+	    fprintf(stderr,
+		    "error: mpmc push/pop mismatch!\n"
+		    "Payload Index: %d\n", i);
+	    errors++;
+	}
+    }
+
+    /* Test that pop fails when empty */
+    if(mpmc_queue_pop(&mq) || !mpmc_queue_is_empty(&mq)){
+	fprintf(stderr,
+		"error: mpmc_queue_pop did not return"
+		" NULL when empty!\n");
+	errors++;
+    }
+
+    /* Threaded test: every item pushed is popped exactly once */
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_create(&producers[i], NULL, mpmc_producer,
+		       (void*)((long)i * MPMC_ITEMS));
+	pthread_create(&consumers[i], NULL, mpmc_consumer, NULL);
+    }
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_join(producers[i], NULL);
+	pthread_join(consumers[i], NULL);
+    }
+    for(i=0; i<MPMC_THREADS; i++){
+	expected += (long)i * MPMC_ITEMS * MPMC_ITEMS
+	    + ((long)MPMC_ITEMS * (MPMC_ITEMS + 1)) / 2;
+    }
+    if(mpmc_sum != expected || !mpmc_queue_is_empty(&mq)){
+	fprintf(stderr,
+		"error: mpmc threaded test lost or duplicated items!\n"
+		"Expected Sum: %ld, Actual Sum: %ld\n",
+		expected, mpmc_sum);
+	errors++;
+    }
+
+    /* Blocking test: consumers sleep until items arrive and
+     * exit once the queue is closed and drained */
+    mpmc_sum = 0;
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_create(&consumers[i], NULL, mpmc_wait_consumer, NULL);
+    }
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_create(&producers[i], NULL, mpmc_wait_producer,
+		       (void*)((long)i * MPMC_ITEMS));
+    }
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_join(producers[i], NULL);
+    }
+    mpmc_queue_close(&mq);
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_join(consumers[i], NULL);
+    }
+    if(mpmc_sum != expected || !mpmc_queue_is_empty(&mq)){
+	fprintf(stderr,
+		"error: mpmc blocking test lost or duplicated items!\n"
+		"Expected Sum: %ld, Actual Sum: %ld\n",
+		expected, mpmc_sum);
+	errors++;
+    }
+
+    /* Batch test: same check using the batched calls */
+    mpmc_queue_cleanup(&mq);
+    mpmc_queue_init(&mq, MPMC_TEST_SIZE);
+    if(mpmc_queue_push_n(&mq, (void**)payload_in, TEST_SIZE) != TEST_SIZE ||
+       mpmc_queue_push_n(&mq, (void**)payload_in, TEST_SIZE)
+       != qSize - TEST_SIZE){
+	fprintf(stderr,
+		"error: mpmc_queue_push_n did not stop when full!\n");
+	errors++;
+    }
+    if(mpmc_queue_pop_n(&mq, (void**)payload_out, MPMC_TEST_SIZE)
+       != qSize || payload_out[TEST_SIZE] != payload_in[0] ||
+       mpmc_queue_pop_n(&mq, (void**)payload_out, 1) != 0){
+	fprintf(stderr,
+		"error: mpmc_queue_pop_n returned wrong items!\n");
+	errors++;
+    }
+    mpmc_sum = 0;
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_create(&consumers[i], NULL, mpmc_batch_consumer, NULL);
+	pthread_create(&producers[i], NULL, mpmc_batch_producer,
+		       (void*)((long)i * MPMC_ITEMS));
+    }
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_join(producers[i], NULL);
+    }
+    mpmc_queue_close(&mq);
+    for(i=0; i<MPMC_THREADS; i++){
+	pthread_join(consumers[i], NULL);
+    }
+    if(mpmc_sum != expected || !mpmc_queue_is_empty(&mq)){
+	fprintf(stderr,
+		"error: mpmc batch test lost or duplicated items!\n"
+		"Expected Sum: %ld, Actual Sum: %ld\n",
+		expected, mpmc_sum);
+	errors++;
+    }
+
+    /* Test that push fails once closed */
+    if(mpmc_queue_push_wait(&mq, payload_in[0]) != QUEUE_FAILURE){
+	fprintf(stderr,
+		"error: mpmc_queue_push_wait did not fail"
+		" when closed!\n");
+	errors++;
+    }
+
+    /* Cleanup Queue */
+    mpmc_queue_cleanup(&mq);
+
+    return errors;
+}
 
 int main(int argc, char* argv[]){
 
@@ -157,6 +432,12 @@ int main(int argc, char* argv[]){
     /* Cleanup Queue */
     queue_cleanup(&q);
 
+    /* Run the same checks against the lock-free queue */
+    if(test_mpmc_queue(payload_in)){
+	fprintf(stderr,
+		"error: mpmc queue tests failed\n");
+    }
+
     /* Cleanup payload_in */
     for(i=0; i<TEST_SIZE; i++){
 	free(payload_in[i]);
@@ -0,0 +1,140 @@
+/*
+ * File: reorder.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a bounded reorder buffer.
+ *      Line seq waits in slot seq % window. Whichever thread puts the
+ *      next line in sequence copies it and every ready line after it
+ *      into one output buffer, so writes stay large and sequential.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reorder.h"
+
+int reorder_init(reorder* r, unsigned long window, int fd){
+    r->slots = calloc(window, sizeof(reorder_slot));
+    if(!r->slots){
+	perror("Error on reorder Malloc");
+	return REORDER_FAILURE;
+    }
+    if(outbuf_init(&r->out, fd, 0, NULL) == OUTBUF_FAILURE){
+	free(r->slots);
+	return REORDER_FAILURE;
+    }
+    if(pthread_mutex_init(&r->lock, NULL) ||
+       pthread_cond_init(&r->space, NULL)){
+	fprintf(stderr, "Error creating reorder lock\n");
+	outbuf_cleanup(&r->out);
+	free(r->slots);
+	return REORDER_FAILURE;
+    }
+    r->window = window;
+    r->next = 0;
+    r->held = 0;
+    r->peak = 0;
+    r->stalls = 0;
+
+    return REORDER_SUCCESS;
+}
+
+void reorder_wait(reorder* r, unsigned long seq){
+    pthread_mutex_lock(&r->lock);
+    if(seq >= r->next + r->window){
+	r->stalls++;
+	while(seq >= r->next + r->window){
+	    pthread_cond_wait(&r->space, &r->lock);
+	}
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+int reorder_put(reorder* r, unsigned long seq, const char* line,
+		size_t len){
+    reorder_slot* slot;
+    char* data;
+    char* dst;
+    unsigned long start;
+    int ret = REORDER_SUCCESS;
+
+    pthread_mutex_lock(&r->lock);
+    slot = &r->slots[seq % r->window];
+
+    /* Hold The Line, A Lost Line Still Takes Its Turn */
+    if(len > slot->cap){
+	data = realloc(slot->data, len);
+	if(data){
+	    slot->data = data;
+	    slot->cap = len;
+	}
+	else{
+	    perror("Error on reorder Malloc");
+	    len = 0;
+	    ret = REORDER_FAILURE;
+	}
+    }
+    if(len){
+	memcpy(slot->data, line, len);
+    }
+    slot->len = len;
+    slot->ready = 1;
+    if(++r->held > r->peak){
+	r->peak = r->held;
+    }
+
+    /* Write Out Every Ready Line In Sequence */
+    start = r->next;
+    slot = &r->slots[r->next % r->window];
+    while(slot->ready){
+	dst = outbuf_reserve(&r->out, slot->len);
+	if(dst){
+	    memcpy(dst, slot->data, slot->len);
+	    outbuf_commit(&r->out, slot->len);
+	}
+	else if(slot->len){
+	    ret = REORDER_FAILURE;
+	}
+	slot->ready = 0;
+	r->held--;
+	r->next++;
+	slot = &r->slots[r->next % r->window];
+    }
+    if(r->next != start){
+	pthread_cond_broadcast(&r->space);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return ret;
+}
+
+int reorder_flush(reorder* r){
+    int ret;
+
+    pthread_mutex_lock(&r->lock);
+    ret = outbuf_flush(&r->out) == OUTBUF_SUCCESS ?
+	REORDER_SUCCESS : REORDER_FAILURE;
+    pthread_mutex_unlock(&r->lock);
+
+    return ret;
+}
+
+void reorder_report(reorder* r, FILE* fp){
+    fprintf(fp, "Reorder: window %lu, peak %lu lines held, "
+	    "%lu requester stalls\n", r->window, r->peak, r->stalls);
+}
+
+void reorder_cleanup(reorder* r){
+    unsigned long i;
+
+    outbuf_cleanup(&r->out);
+    for(i=0; i<r->window; i++){
+	free(r->slots[i].data);
+    }
+    free(r->slots);
+    pthread_cond_destroy(&r->space);
+    pthread_mutex_destroy(&r->lock);
+}
@@ -0,0 +1,74 @@
+/*
+ * File: reorder.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a bounded reorder buffer. Lines are
+ *      numbered in input order and may be put from any thread in any
+ *      order; they are written out in sequence. The producer waits
+ *      before numbering a line more than window past the oldest line
+ *      not yet written, so at most window lines are ever held.
+ *
+ */
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "outbuf.h"
+
+#define REORDER_FAILURE -1
+#define REORDER_SUCCESS 0
+
+#define REORDER_DEFAULT_WINDOW 4096
+
+typedef struct reorder_slot_s{
+    int ready;
+    char* data;
+    size_t len;
+    size_t cap;
+} reorder_slot;
+
+typedef struct reorder_s{
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+    reorder_slot* slots;
+    unsigned long window;
+    /* next sequence number to write */
+    unsigned long next;
+    unsigned long held;
+    unsigned long peak;
+    unsigned long stalls;
+    outbuf out;
+} reorder;
+
+/* Function to initilze a buffer of window lines writing to fd
+ * Returns REORDER_SUCCESS or REORDER_FAILURE
+ */
+int reorder_init(reorder* r, unsigned long window, int fd);
+
+/* Function to wait until line seq fits in the window */
+void reorder_wait(reorder* r, unsigned long seq);
+
+/* Function to put line seq, writing it and any lines after it
+ * that were waiting on it
+ * Returns REORDER_SUCCESS or REORDER_FAILURE if the line was lost
+ */
+int reorder_put(reorder* r, unsigned long seq, const char* line,
+		size_t len);
+
+/* Function to write out the lines already in sequence
+ * Returns REORDER_SUCCESS or REORDER_FAILURE
+ */
+int reorder_flush(reorder* r);
+
+/* Function to print how full the window got */
+void reorder_report(reorder* r, FILE* fp);
+
+/* Function to flush what was written and free the buffer */
+void reorder_cleanup(reorder* r);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * File: resfile-text.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains a converter from the binary result format
+ *      written by multi-lookup -B back to its text format, one
+ *      "name,addr,addr" line per record.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "resfile.h"
+
+#define USAGE "<binaryResultPath|-> [outputFilePath]"
+#define TEXT_LINE (RESFILE_MAX_NAME + RESFILE_MAX_ADDRS * INET6_ADDRSTRLEN + \
+		   RESFILE_RETRY_TEXT + 2)
+
+int main(int argc, char* argv[]){
+
+    resfile_reader reader;
+    resfile_record* rec;
+    char* line;
+    FILE* outputfp = stdout;
+    size_t len;
+    int inputfd = STDIN_FILENO;
+    int rc = EXIT_SUCCESS;
+    int n;
+
+    if(argc < 2 || argc > 3){
+	fprintf(stderr, "Usage:\n %s %s\n", argv[0], USAGE);
+	return EXIT_FAILURE;
+    }
+
+    /* Open Input and Output Files */
+    if(strcmp(argv[1], "-") != 0){
+	inputfd = open(argv[1], O_RDONLY);
+	if(inputfd < 0){
+	    perror("Error Opening Input File");
+	    return EXIT_FAILURE;
+	}
+    }
+    if(argc == 3){
+	outputfp = fopen(argv[2], "w");
+	if(!outputfp){
+	    perror("Error Opening Output File");
+	    close(inputfd);
+	    return EXIT_FAILURE;
+	}
+    }
+
+    rec = malloc(sizeof(resfile_record));
+    line = malloc(TEXT_LINE);
+    if(!rec || !line || resfile_open(&reader, inputfd) == RESFILE_FAILURE){
+	free(rec);
+	free(line);
+	close(inputfd);
+	if(outputfp != stdout){
+	    fclose(outputfp);
+	}
+	return EXIT_FAILURE;
+    }
+
+    /* Convert Each Record */
+    while((n = resfile_next(&reader, rec)) == 1){
+	len = resfile_format_text(rec, line);
+	fwrite(line, 1, len, outputfp);
+    }
+    if(n == RESFILE_FAILURE){
+	rc = EXIT_FAILURE;
+    }
+
+    /* Cleanup */
+    resfile_close(&reader);
+    free(rec);
+    free(line);
+    close(inputfd);
+    if(outputfp != stdout && fclose(outputfp)){
+	perror("Error Closing Output File");
+	rc = EXIT_FAILURE;
+    }
+
+    return rc;
+}
@@ -0,0 +1,221 @@
+/*
+ * File: resfile.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of the binary result format.
+ *      The reader refills a large buffer with read() and decodes
+ *      records in place.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "resfile.h"
+
+int resfile_write_magic(int fd){
+    if(write(fd, RESFILE_MAGIC, RESFILE_MAGIC_LEN) != RESFILE_MAGIC_LEN){
+	perror("Error writing result file magic");
+	return RESFILE_FAILURE;
+    }
+    return RESFILE_SUCCESS;
+}
+
+size_t resfile_encode_head(char* out, const char* name, size_t len,
+			   int status, int retries){
+    unsigned char* p = (unsigned char*)out;
+
+    if(len > RESFILE_MAX_NAME){
+	return 0;
+    }
+    p[0] = len >> 8;
+    p[1] = len & 0xFF;
+    memcpy(p + 2, name, len);
+    if(retries > RESFILE_MAX_RETRIES){
+	retries = RESFILE_MAX_RETRIES;
+    }
+    p[2 + len] = (unsigned char)((-status & 0x0F) | (retries << 4));
+
+    return RESFILE_HEAD_SIZE(len);
+}
+
+size_t resfile_encode_addrs(char* out, const util_addr* addrs,
+			    int numAddrs){
+    unsigned char* p = (unsigned char*)out;
+    size_t len = 1;
+    size_t size;
+    int count = 0;
+    int i;
+
+    for(i=0; i<numAddrs && count<RESFILE_MAX_ADDRS; i++){
+	size = addrs[i].family == AF_INET6 ? 16 : 4;
+	p[len++] = size == 16 ? 6 : 4;
+	memcpy(p + len, addrs[i].addr, size);
+	len += size;
+	count++;
+    }
+    p[0] = count;
+
+    return len;
+}
+
+int resfile_open(resfile_reader* r, int fd){
+    char magic[RESFILE_MAGIC_LEN];
+    ssize_t n;
+    size_t got = 0;
+
+    while(got < RESFILE_MAGIC_LEN){
+	n = read(fd, magic + got, RESFILE_MAGIC_LEN - got);
+	if(n < 0 && errno == EINTR){
+	    continue;
+	}
+	if(n <= 0){
+	    break;
+	}
+	got += n;
+    }
+    if(got < RESFILE_MAGIC_LEN ||
+       memcmp(magic, RESFILE_MAGIC, RESFILE_MAGIC_LEN) != 0){
+	fprintf(stderr, "Not a binary result file\n");
+	return RESFILE_FAILURE;
+    }
+
+    r->data = malloc(RESFILE_BUFFER_SIZE);
+    if(!r->data){
+	perror("Error on result reader Malloc");
+	return RESFILE_FAILURE;
+    }
+    r->fd = fd;
+    r->pos = 0;
+    r->len = 0;
+    r->eof = 0;
+
+    return RESFILE_SUCCESS;
+}
+
+/* Make at least want bytes available past pos
+ * Returns 1 if they are, 0 if the file ends first, RESFILE_FAILURE on
+ * a read error
+ */
+static int resfile_fill(resfile_reader* r, size_t want){
+    ssize_t n;
+
+    if(r->len - r->pos >= want){
+	return 1;
+    }
+
+    /* Slide what is left to the front, then read after it */
+    memmove(r->data, r->data + r->pos, r->len - r->pos);
+    r->len -= r->pos;
+    r->pos = 0;
+    while(!r->eof && r->len < want){
+	n = read(r->fd, r->data + r->len, RESFILE_BUFFER_SIZE - r->len);
+	if(n < 0 && errno == EINTR){
+	    continue;
+	}
+	if(n < 0){
+	    perror("Error reading result file");
+	    return RESFILE_FAILURE;
+	}
+	if(n == 0){
+	    r->eof = 1;
+	}
+	r->len += n;
+    }
+
+    return r->len >= want;
+}
+
+int resfile_next(resfile_reader* r, resfile_record* rec){
+    const unsigned char* p;
+    size_t need;
+    size_t size;
+    size_t at;
+    int rc;
+    int i;
+
+    /* Name Length, Then The Whole Record Up To The Address Count */
+    rc = resfile_fill(r, 2);
+    if(rc <= 0){
+	if(rc == 0 && r->len > r->pos){
+	    fprintf(stderr, "Truncated result record\n");
+	    return RESFILE_FAILURE;
+	}
+	return rc;
+    }
+    p = (const unsigned char*)r->data + r->pos;
+    rec->len = (p[0] << 8) | p[1];
+    need = RESFILE_HEAD_SIZE(rec->len) + 1;
+    if((rc = resfile_fill(r, need)) <= 0){
+	goto truncated;
+    }
+
+    /* Addresses, Sized By Their Family Bytes */
+    p = (const unsigned char*)r->data + r->pos;
+    rec->num_addrs = p[need - 1];
+    for(i=0; i<rec->num_addrs; i++){
+	if((rc = resfile_fill(r, need + 1)) <= 0){
+	    goto truncated;
+	}
+	p = (const unsigned char*)r->data + r->pos;
+	size = p[need] == 6 ? 16 : 4;
+	need += 1 + size;
+    }
+    if((rc = resfile_fill(r, need)) <= 0){
+	goto truncated;
+    }
+
+    p = (const unsigned char*)r->data + r->pos;
+    rec->name = (const char*)p + 2;
+    rec->status = -(int)(p[2 + rec->len] & 0x0F);
+    rec->retries = p[2 + rec->len] >> 4;
+    at = RESFILE_HEAD_SIZE(rec->len) + 1;
+    for(i=0; i<rec->num_addrs; i++){
+	size = p[at] == 6 ? 16 : 4;
+	rec->addrs[i].family = size == 16 ? AF_INET6 : AF_INET;
+	memcpy(rec->addrs[i].addr, p + at + 1, size);
+	at += 1 + size;
+    }
+    r->pos += need;
+
+    return 1;
+
+ truncated:
+    if(rc == 0){
+	fprintf(stderr, "Truncated result record\n");
+    }
+    return RESFILE_FAILURE;
+}
+
+size_t resfile_format_text(const resfile_record* rec, char* out){
+    size_t len = rec->len;
+    int i;
+
+    memcpy(out, rec->name, rec->len);
+    if(rec->status != UTIL_SUCCESS){
+	out[len++] = ',';
+    }
+    else{
+	for(i=0; i<rec->num_addrs; i++){
+	    out[len++] = ',';
+	    inet_ntop(rec->addrs[i].family, rec->addrs[i].addr, out + len,
+		      INET6_ADDRSTRLEN);
+	    len += strlen(out + len);
+	}
+    }
+    if(rec->retries){
+	len += sprintf(out + len, RESFILE_RETRY_FORMAT, rec->retries);
+    }
+    out[len++] = '\n';
+
+    return len;
+}
+
+void resfile_close(resfile_reader* r){
+    free(r->data);
+    r->data = NULL;
+}
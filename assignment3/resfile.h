@@ -0,0 +1,111 @@
+/*
+ * File: resfile.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for the binary result format. A file
+ *      starts with the 4 byte magic "MLR1" followed by one record per
+ *      name:
+ *
+ *          u16    name length, big endian
+ *          bytes  name, not NUL terminated
+ *          u8     lookup status, negated (0 success, 2 not found, ...)
+ *                 in the low 4 bits, retries before it in the high 4
+ *          u8     address count
+ *          per address:
+ *          u8     4 or 6
+ *          bytes  4 or 16 byte address, network order
+ *
+ *      Records from different threads may be in any order, the same as
+ *      lines of the text format.
+ *
+ */
+
+#ifndef RESFILE_H
+#define RESFILE_H
+
+#include <stddef.h>
+
+#include "util.h"
+
+#define RESFILE_FAILURE -1
+#define RESFILE_SUCCESS 0
+
+#define RESFILE_MAGIC "MLR1"
+#define RESFILE_MAGIC_LEN 4
+#define RESFILE_MAX_NAME 0xFFFF
+#define RESFILE_MAX_ADDRS 0xFF
+#define RESFILE_BUFFER_SIZE (1024 * 1024)
+#define RESFILE_MAX_RETRIES 15
+
+/* Text lines of names that were retried end with this */
+#define RESFILE_RETRY_FORMAT " retries=%d"
+#define RESFILE_RETRY_TEXT 16
+
+/* Largest record head and address list */
+#define RESFILE_HEAD_SIZE(nameLen) (2 + (nameLen) + 1)
+#define RESFILE_ADDRS_SIZE(numAddrs) (1 + (numAddrs) * 17)
+
+/* One decoded record
+ * name points into the reader's buffer and is valid until the next read
+ */
+typedef struct resfile_record_s{
+    const char* name;
+    size_t len;
+    int status;
+    int retries;
+    int num_addrs;
+    util_addr addrs[RESFILE_MAX_ADDRS];
+} resfile_record;
+
+typedef struct resfile_reader_s{
+    int fd;
+    char* data;
+    size_t pos;
+    size_t len;
+    int eof;
+} resfile_reader;
+
+/* Function to write the magic at the start of a new file
+ * Returns RESFILE_SUCCESS or RESFILE_FAILURE
+ */
+int resfile_write_magic(int fd);
+
+/* Function to encode a record head for len bytes of name
+ * out needs RESFILE_HEAD_SIZE(len) bytes
+ * Returns the bytes written, 0 if the name is too long
+ */
+size_t resfile_encode_head(char* out, const char* name, size_t len,
+			   int status, int retries);
+
+/* Function to encode an address list as util_lookup returned it
+ * out needs RESFILE_ADDRS_SIZE(numAddrs) bytes
+ * Returns the bytes written
+ */
+size_t resfile_encode_addrs(char* out, const util_addr* addrs,
+			    int numAddrs);
+
+/* Function to start reading records from fd, checking the magic
+ * Returns RESFILE_SUCCESS or RESFILE_FAILURE
+ */
+int resfile_open(resfile_reader* r, int fd);
+
+/* Function to read the next record
+ * Returns 1 with rec filled, 0 at the end of the file or
+ * RESFILE_FAILURE on a read error or truncated record
+ */
+int resfile_next(resfile_reader* r, resfile_record* rec);
+
+/* Function to format a record as a line of the text format,
+ * "name,addr,addr\n" or "name,\n" when the lookup failed, with
+ * RESFILE_RETRY_FORMAT before the newline if it was retried
+ * out needs len + RESFILE_MAX_ADDRS * INET6_ADDRSTRLEN +
+ * RESFILE_RETRY_TEXT + 2 bytes
+ * Returns the bytes written
+ */
+size_t resfile_format_text(const resfile_record* rec, char* out);
+
+/* Function to free the reader, the descriptor is not closed */
+void resfile_close(resfile_reader* r);
+
+#endif
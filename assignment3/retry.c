@@ -0,0 +1,227 @@
+/*
+ * File: retry.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a hierarchical timer
+ *      wheel. Level 0 holds timers due within RETRY_SLOTS ticks, one
+ *      slot per tick; level 1 holds later ones, one slot per
+ *      RETRY_SLOTS ticks, and a slot is cascaded down into level 0 each
+ *      time level 0 wraps. Scheduling and expiry are O(1) per timer.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "retry.h"
+
+static unsigned long long retry_now_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Must hold lock, links t into the slot for its due tick */
+static void retry_link(retry* r, retry_timer* t){
+    unsigned long long delta = t->due - r->tick;
+    retry_timer** slot;
+
+    if(t->due <= r->tick){
+	/* due now, fires on the next tick */
+	t->due = r->tick + 1;
+	delta = 1;
+    }
+    if(delta < RETRY_SLOTS){
+	slot = &r->slots[0][t->due & (RETRY_SLOTS - 1)];
+    }
+    else{
+	if(delta >= (unsigned long long)RETRY_SLOTS * RETRY_SLOTS){
+	    t->due = r->tick + (unsigned long long)RETRY_SLOTS * RETRY_SLOTS - 1;
+	}
+	slot = &r->slots[1][(t->due >> RETRY_SLOT_BITS) & (RETRY_SLOTS - 1)];
+    }
+    t->next = *slot;
+    *slot = t;
+}
+
+/* Must hold lock, moves on one tick
+ * Returns the timers now due, linked through next
+ */
+static retry_timer* retry_advance(retry* r){
+    retry_timer* due;
+    retry_timer* t;
+    retry_timer* next;
+    int slot;
+
+    r->tick++;
+
+    /* Level 0 Wrapped, Bring The Next Level 1 Slot Down */
+    if((r->tick & (RETRY_SLOTS - 1)) == 0){
+	slot = (r->tick >> RETRY_SLOT_BITS) & (RETRY_SLOTS - 1);
+	t = r->slots[1][slot];
+	r->slots[1][slot] = NULL;
+	for(; t != NULL; t = next){
+	    next = t->next;
+	    retry_link(r, t);
+	}
+    }
+
+    slot = r->tick & (RETRY_SLOTS - 1);
+    due = r->slots[0][slot];
+    r->slots[0][slot] = NULL;
+
+    return due;
+}
+
+static void* retry_thread(void* arg){
+    retry* r = arg;
+    retry_timer* due;
+    retry_timer* t;
+    unsigned long long target;
+    unsigned long long wake;
+    struct timespec ts;
+
+    pthread_mutex_lock(&r->lock);
+    while(!r->closed){
+	/* Sleep Until Something Is Scheduled */
+	if(r->waiting == 0){
+	    pthread_cond_wait(&r->work, &r->lock);
+	    continue;
+	}
+
+	/* Catch Up Every Tick That Has Passed */
+	target = (retry_now_ms() - r->startMs) / RETRY_TICK_MS;
+	while(r->tick < target && !r->closed){
+	    due = retry_advance(r);
+	    while(due){
+		t = due;
+		due = t->next;
+		r->waiting--;
+		pthread_mutex_unlock(&r->lock);
+		r->fire(t->payload, r->arg);
+		pthread_mutex_lock(&r->lock);
+		t->next = r->free;
+		r->free = t;
+	    }
+	}
+
+	wake = r->startMs + (r->tick + 1) * RETRY_TICK_MS;
+	ts.tv_sec = wake / 1000;
+	ts.tv_nsec = (wake % 1000) * 1000000;
+	pthread_cond_timedwait(&r->work, &r->lock, &ts);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+int retry_init(retry* r, long baseMs, void (*fire)(void*, void*),
+	       void* arg){
+    pthread_condattr_t attr;
+
+    memset(r, 0, sizeof(retry));
+    r->fire = fire;
+    r->arg = arg;
+    r->baseMs = baseMs > 0 ? baseMs : RETRY_DEFAULT_BASE_MS;
+    r->startMs = retry_now_ms();
+    r->seed = r->startMs | 1;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if(pthread_mutex_init(&r->lock, NULL) ||
+       pthread_cond_init(&r->work, &attr)){
+	fprintf(stderr, "Error on retry mutex setup\n");
+	pthread_condattr_destroy(&attr);
+	return RETRY_FAILURE;
+    }
+    pthread_condattr_destroy(&attr);
+
+    if(pthread_create(&r->thread, NULL, retry_thread, r)){
+	fprintf(stderr, "Error creating retry thread\n");
+	pthread_cond_destroy(&r->work);
+	pthread_mutex_destroy(&r->lock);
+	return RETRY_FAILURE;
+    }
+
+    return RETRY_SUCCESS;
+}
+
+int retry_schedule(retry* r, void* payload, int attempt){
+    unsigned long long delay;
+    retry_timer* t;
+
+    delay = attempt < 20 ? (unsigned long long)r->baseMs << attempt :
+	RETRY_MAX_DELAY_MS;
+    if(delay > RETRY_MAX_DELAY_MS){
+	delay = RETRY_MAX_DELAY_MS;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    t = r->free;
+    if(t){
+	r->free = t->next;
+    }
+    else if((t = malloc(sizeof(retry_timer))) == NULL){
+	pthread_mutex_unlock(&r->lock);
+	return RETRY_FAILURE;
+    }
+
+    /* Equal Jitter, xorshift64 Under The Lock */
+    r->seed ^= r->seed << 13;
+    r->seed ^= r->seed >> 7;
+    r->seed ^= r->seed << 17;
+    delay = delay / 2 + r->seed % (delay / 2 + 1);
+
+    /* An Idle Wheel Stops, Its Clock Jumps To Now */
+    if(r->waiting == 0){
+	r->tick = (retry_now_ms() - r->startMs) / RETRY_TICK_MS;
+    }
+    t->payload = payload;
+    t->due = r->tick + (delay + RETRY_TICK_MS - 1) / RETRY_TICK_MS;
+    retry_link(r, t);
+    r->scheduled++;
+    if(++r->waiting > r->peak){
+	r->peak = r->waiting;
+    }
+    if(r->waiting == 1){
+	pthread_cond_signal(&r->work);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return RETRY_SUCCESS;
+}
+
+void retry_report(retry* r, FILE* fp){
+    fprintf(fp, "Retry: %lu retries scheduled, peak %lu waiting\n",
+	    r->scheduled, r->peak);
+}
+
+void retry_cleanup(retry* r){
+    retry_timer* t;
+    int level;
+    int slot;
+
+    pthread_mutex_lock(&r->lock);
+    r->closed = 1;
+    pthread_cond_signal(&r->work);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+
+    for(level=0; level<RETRY_LEVELS; level++){
+	for(slot=0; slot<RETRY_SLOTS; slot++){
+	    while((t = r->slots[level][slot]) != NULL){
+		r->slots[level][slot] = t->next;
+		free(t);
+	    }
+	}
+    }
+    while((t = r->free) != NULL){
+	r->free = t->next;
+	free(t);
+    }
+    pthread_cond_destroy(&r->work);
+    pthread_mutex_destroy(&r->lock);
+}
@@ -0,0 +1,74 @@
+/*
+ * File: retry.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a retry scheduler built on a two
+ *      level hierarchical timer wheel. Scheduling only links a timer
+ *      into a slot under a lock, so resolver threads never sleep on a
+ *      retry; one timer thread advances the wheel a tick at a time and
+ *      hands each due payload back through a callback. Delays back off
+ *      exponentially with equal jitter.
+ *
+ */
+
+#ifndef RETRY_H
+#define RETRY_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define RETRY_FAILURE -1
+#define RETRY_SUCCESS 0
+
+#define RETRY_TICK_MS 10
+#define RETRY_SLOT_BITS 8
+#define RETRY_SLOTS (1 << RETRY_SLOT_BITS)
+#define RETRY_LEVELS 2
+#define RETRY_DEFAULT_BASE_MS 200
+#define RETRY_MAX_DELAY_MS 10000
+
+typedef struct retry_timer_s{
+    struct retry_timer_s* next;
+    unsigned long long due;
+    void* payload;
+} retry_timer;
+
+typedef struct retry_s{
+    void (*fire)(void* payload, void* arg);
+    void* arg;
+    long baseMs;
+    retry_timer* slots[RETRY_LEVELS][RETRY_SLOTS];
+    retry_timer* free;
+    unsigned long long tick;
+    unsigned long long startMs;
+    unsigned long long seed;
+    unsigned long waiting;
+    unsigned long peak;
+    unsigned long scheduled;
+    int closed;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+} retry;
+
+/* Function to start the timer thread, which calls fire(payload, arg)
+ * for each retry as it comes due; fire may block
+ * Returns RETRY_SUCCESS or RETRY_FAILURE
+ */
+int retry_init(retry* r, long baseMs, void (*fire)(void*, void*),
+	       void* arg);
+
+/* Function to fire payload after its attempt'th backoff, a random
+ * delay between half and all of baseMs << attempt, capped
+ * Returns RETRY_SUCCESS or RETRY_FAILURE
+ */
+int retry_schedule(retry* r, void* payload, int attempt);
+
+/* Function to print how many retries were scheduled */
+void retry_report(retry* r, FILE* fp);
+
+/* Function to stop the timer thread, dropping retries not yet due */
+void retry_cleanup(retry* r);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * File: scan.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a memory-mapped input
+ *      scanner. Whitespace is classified 16 bytes at a time with SSE2
+ *      where available and a byte at a time otherwise.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scan.h"
+
+#define SCAN_ALIGN_CHUNK 4096
+
+/* Same set as isspace() in the C locale: ' ', \t \n \v \f \r */
+static int scan_is_space(unsigned char c){
+    return c == ' ' || (unsigned char)(c - '\t') <= ('\r' - '\t');
+}
+
+#ifdef __SSE2__
+/* Bit i set if p[i] is whitespace */
+static unsigned scan_space_mask16(const char* p){
+    __m128i b = _mm_loadu_si128((const __m128i*)p);
+    __m128i t = _mm_sub_epi8(b, _mm_set1_epi8('\t'));
+    __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8('\r' - '\t')), t);
+    __m128i sp = _mm_cmpeq_epi8(b, _mm_set1_epi8(' '));
+
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(ctl, sp));
+}
+#endif
+
+/* Index of first byte in [pos,end) whose space-ness equals want */
+static size_t scan_find(const char* data, size_t pos, size_t end, int want){
+#ifdef __SSE2__
+    unsigned mask;
+
+    while(pos + 16 <= end){
+	mask = scan_space_mask16(data + pos);
+	if(!want){
+	    mask = ~mask & 0xFFFF;
+	}
+	if(mask){
+	    return pos + __builtin_ctz(mask);
+	}
+	pos += 16;
+    }
+#endif
+    while(pos < end && scan_is_space(data[pos]) != want){
+	pos++;
+    }
+
+    return pos;
+}
+
+int scan_map_file(const char* path, scan_map* map){
+    struct stat st;
+    void* data;
+    int fd;
+
+    map->data = NULL;
+    map->size = 0;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+	return SCAN_FAILURE;
+    }
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode)){
+	close(fd);
+	return SCAN_FAILURE;
+    }
+    if(st.st_size == 0){
+	close(fd);
+	return SCAN_SUCCESS;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+	return SCAN_FAILURE;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    map->data = data;
+    map->size = st.st_size;
+
+    return SCAN_SUCCESS;
+}
+
+void scan_unmap_file(scan_map* map){
+    if(map->data){
+	munmap((void*)map->data, map->size);
+    }
+    map->data = NULL;
+    map->size = 0;
+}
+
+off_t scan_align_fd(int fd, off_t pos, off_t end){
+    char buf[SCAN_ALIGN_CHUNK];
+    ssize_t got;
+    size_t i;
+
+    while(pos < end){
+	got = pread(fd, buf, sizeof(buf), pos);
+	if(got <= 0){
+	    return end;
+	}
+	i = scan_find(buf, 0, got, 1);
+	if(i < (size_t)got){
+	    return pos + (off_t)i < end ? pos + (off_t)i : end;
+	}
+	pos += got;
+    }
+
+    return end;
+}
+
+void scan_cursor_init(scan_cursor* c, const char* data,
+		      size_t pos, size_t end){
+    c->data = data;
+    c->pos = pos;
+    c->end = end;
+}
+
+size_t scan_next_token(scan_cursor* c, const char** token, size_t maxLen){
+    size_t start;
+    size_t stop;
+
+    start = scan_find(c->data, c->pos, c->end, 0);
+    if(start >= c->end){
+	c->pos = c->end;
+	return 0;
+    }
+
+    stop = scan_find(c->data, start, c->end, 1);
+    if(stop - start > maxLen){
+	stop = start + maxLen;
+    }
+
+    *token = c->data + start;
+    c->pos = stop;
+
+    return stop - start;
+}
@@ -0,0 +1,58 @@
+/*
+ * File: scan.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a memory-mapped input scanner. A file
+ *      is mapped read-only and split into whitespace separated tokens
+ *      in place, the same tokens fscanf("%s") would return, without
+ *      copying them.
+ *
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define SCAN_FAILURE -1
+#define SCAN_SUCCESS 0
+
+typedef struct scan_map_s{
+    const char* data;
+    size_t size;
+} scan_map;
+
+typedef struct scan_cursor_s{
+    const char* data;
+    size_t pos;
+    size_t end;
+} scan_cursor;
+
+/* Function to map a whole file read-only
+ * Returns SCAN_SUCCESS or SCAN_FAILURE
+ * Empty files map to a NULL data pointer of size 0
+ */
+int scan_map_file(const char* path, scan_map* map);
+
+/* Function to unmap a file mapped by scan_map_file */
+void scan_unmap_file(scan_map* map);
+
+/* Function to move an offset in an open file forward to whitespace
+ * Returns the offset of the first whitespace byte in [pos,end),
+ * or end if there is none
+ */
+off_t scan_align_fd(int fd, off_t pos, off_t end);
+
+/* Function to start scanning data[pos] up to data[end] */
+void scan_cursor_init(scan_cursor* c, const char* data,
+		      size_t pos, size_t end);
+
+/* Function to find the next token
+ * Tokens longer than maxLen are split, like fscanf field widths
+ * Returns the token length and sets *token, 0 at the end
+ */
+size_t scan_next_token(scan_cursor* c, const char** token, size_t maxLen);
+
+#endif
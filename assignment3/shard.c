@@ -0,0 +1,173 @@
+/*
+ * File: shard.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of a set of hash-sharded
+ *      queues with work stealing, built on mpmcqueue.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "shard.h"
+
+int shard_init(shard_set* s, int count, int capacity){
+    int i;
+
+    s->queues = malloc(sizeof(mpmc_queue) * count);
+    if(!s->queues){
+	perror("Error on shard Malloc");
+	return SHARD_FAILURE;
+    }
+    for(i=0; i<count; i++){
+	if(mpmc_queue_init(&s->queues[i], capacity) == QUEUE_FAILURE){
+	    while(i-- > 0){
+		mpmc_queue_cleanup(&s->queues[i]);
+	    }
+	    free(s->queues);
+	    return SHARD_FAILURE;
+	}
+    }
+    if(pthread_mutex_init(&s->lock, NULL) ||
+       pthread_cond_init(&s->work, NULL)){
+	fprintf(stderr, "Error on shard mutex setup\n");
+	return SHARD_FAILURE;
+    }
+    s->count = count;
+    s->closed = 0;
+    s->sleepers = 0;
+    s->stolen = 0;
+    s->taken = 0;
+
+    return SHARD_SUCCESS;
+}
+
+int shard_of(shard_set* s, const char* name, size_t len){
+    /* 32 bit FNV-1a */
+    unsigned int h = 2166136261U;
+    size_t i;
+
+    for(i=0; i<len; i++){
+	h ^= (unsigned char)name[i];
+	h *= 16777619U;
+    }
+    return h % s->count;
+}
+
+/* Wake sleeping consumers if there are any. The fence pairs with the
+ * sleeper count increment so a sleeper either sees the push on its
+ * rescan or is counted here and gets woken. */
+static void shard_wake(shard_set* s){
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&s->sleepers, __ATOMIC_RELAXED) > 0){
+	pthread_mutex_lock(&s->lock);
+	pthread_cond_broadcast(&s->work);
+	pthread_mutex_unlock(&s->lock);
+    }
+}
+
+int shard_push_n(shard_set* s, int shard, void** payloads, int n){
+    int pushed = mpmc_queue_push_n(&s->queues[shard], payloads, n);
+
+    if(pushed > 0){
+	shard_wake(s);
+    }
+    return pushed;
+}
+
+int shard_push_n_wait(shard_set* s, int shard, void** payloads, int n){
+    int pushed = mpmc_queue_push_n_wait(&s->queues[shard], payloads, n);
+
+    if(pushed > 0){
+	shard_wake(s);
+    }
+    return pushed;
+}
+
+int shard_pop_n(shard_set* s, int home, void** payloads, int n){
+    int count;
+    int i;
+
+    /* Home Queue, Then Neighbours In Turn */
+    for(i=0; i<s->count; i++){
+	count = mpmc_queue_pop_n(&s->queues[(home + i) % s->count],
+				 payloads, n);
+	if(count > 0){
+	    __atomic_add_fetch(i ? &s->stolen : &s->taken, count,
+			       __ATOMIC_RELAXED);
+	    return count;
+	}
+    }
+    return 0;
+}
+
+int shard_pop_n_wait(shard_set* s, int home, void** payloads, int n){
+    int count;
+
+    /* fast path */
+    if((count = shard_pop_n(s, home, payloads, n)) > 0){
+	return count;
+    }
+
+    /* slow path: register as a sleeper, then rescan under the lock */
+    pthread_mutex_lock(&s->lock);
+    __atomic_add_fetch(&s->sleepers, 1, __ATOMIC_SEQ_CST);
+    for(;;){
+	if((count = shard_pop_n(s, home, payloads, n)) > 0){
+	    break;
+	}
+	if(__atomic_load_n(&s->closed, __ATOMIC_ACQUIRE)){
+	    /* a push may have landed between the scan and the check */
+	    count = shard_pop_n(s, home, payloads, n);
+	    break;
+	}
+	pthread_cond_wait(&s->work, &s->lock);
+    }
+    __atomic_sub_fetch(&s->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&s->lock);
+
+    return count;
+}
+
+int shard_size(shard_set* s){
+    int size = 0;
+    int i;
+
+    for(i=0; i<s->count; i++){
+	size += mpmc_queue_size(&s->queues[i]);
+    }
+    return size;
+}
+
+void shard_close(shard_set* s){
+    int i;
+
+    for(i=0; i<s->count; i++){
+	mpmc_queue_close(&s->queues[i]);
+    }
+    pthread_mutex_lock(&s->lock);
+    __atomic_store_n(&s->closed, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&s->work);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void shard_report(shard_set* s, FILE* fp){
+    unsigned long total = s->taken + s->stolen;
+
+    fprintf(fp, "Shards: %d queues, %lu of %lu names stolen (%.1f%%)\n",
+	    s->count, s->stolen, total,
+	    total ? 100.0 * s->stolen / total : 0.0);
+}
+
+void shard_cleanup(shard_set* s){
+    int i;
+
+    for(i=0; i<s->count; i++){
+	mpmc_queue_cleanup(&s->queues[i]);
+    }
+    free(s->queues);
+    pthread_cond_destroy(&s->work);
+    pthread_mutex_destroy(&s->lock);
+}
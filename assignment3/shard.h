@@ -0,0 +1,78 @@
+/*
+ * File: shard.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for a set of hash-sharded queues. Each
+ *      hostname hashes to one queue so repeats of a name go to the same
+ *      consumer. A consumer takes from its home queue first and steals
+ *      from the others, nearest first, when its own is empty. Idle
+ *      consumers sleep on one condition variable that producers only
+ *      touch when someone is asleep.
+ *
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "mpmcqueue.h"
+
+#define SHARD_FAILURE -1
+#define SHARD_SUCCESS 0
+
+typedef struct shard_set_s{
+    mpmc_queue* queues;
+    int count;
+    int closed;
+    int sleepers;
+    unsigned long stolen;
+    unsigned long taken;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+} shard_set;
+
+/* Function to initilze count queues of capacity each
+ * Returns SHARD_SUCCESS or SHARD_FAILURE
+ */
+int shard_init(shard_set* s, int count, int capacity);
+
+/* Function to pick the queue for len bytes of name */
+int shard_of(shard_set* s, const char* name, size_t len);
+
+/* Function to push up to n payloads onto queue shard
+ * Returns the number pushed, fewer than n if it filled
+ */
+int shard_push_n(shard_set* s, int shard, void** payloads, int n);
+
+/* Function to push n payloads onto queue shard, blocking while full
+ * Returns the number pushed, fewer than n only if closed
+ */
+int shard_push_n_wait(shard_set* s, int shard, void** payloads, int n);
+
+/* Function to pop up to n payloads, from queue home first
+ * Returns the number popped, 0 if every queue is empty
+ */
+int shard_pop_n(shard_set* s, int home, void** payloads, int n);
+
+/* Function to pop up to n payloads, blocking while every queue is empty
+ * Returns the number popped, 0 once closed and drained
+ */
+int shard_pop_n_wait(shard_set* s, int home, void** payloads, int n);
+
+/* Function to count payloads waiting in every queue */
+int shard_size(shard_set* s);
+
+/* Function to close every queue and wake all consumers */
+void shard_close(shard_set* s);
+
+/* Function to print how much work was stolen */
+void shard_report(shard_set* s, FILE* fp);
+
+/* Function to free the queues */
+void shard_cleanup(shard_set* s);
+
+#endif
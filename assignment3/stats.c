@@ -0,0 +1,298 @@
+/*
+ * File: stats.c
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This file contains an implementation of per-thread stage timing.
+ *      Blocks are linked into a list when threads start and are only
+ *      freed at cleanup, so a dump can walk them while threads record.
+ *      Owners update their counters with relaxed atomic stores, so a
+ *      dump sees each counter whole, if slightly stale.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+static const char* stats_names[STATS_STAGES] = {
+    "queue_push", "queue_pop", "lookup", "cache_lock", "cache_wait",
+    "output_lock", "output_write", "hedge", "deadline"
+};
+
+static int stats_on = 0;
+static stats_thread* stats_threads = NULL;
+static int stats_num_threads = 0;
+static pthread_mutex_t stats_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread stats_thread* stats_self = NULL;
+
+void stats_enable(void){
+    stats_on = 1;
+}
+
+int stats_enabled(void){
+    return stats_on;
+}
+
+unsigned long long stats_now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stats_thread_start(const char* role){
+    stats_thread* t;
+
+    if(!stats_on || stats_self){
+	return;
+    }
+    if(posix_memalign((void**)&t, STATS_LINE, sizeof(stats_thread))){
+	perror("Error on stats Malloc");
+	return;
+    }
+    memset(t, 0, sizeof(stats_thread));
+    t->role = role;
+
+    pthread_mutex_lock(&stats_list_lock);
+    t->id = stats_num_threads++;
+    t->next = stats_threads;
+    __atomic_store_n(&stats_threads, t, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&stats_list_lock);
+
+    stats_self = t;
+}
+
+static int stats_bucket(unsigned long long v){
+    int e;
+
+    if(v < STATS_SUB){
+	return (int)v;
+    }
+    e = 63 - __builtin_clzll(v);
+    return (e - STATS_SUB_BITS + 1) * STATS_SUB +
+	(int)((v >> (e - STATS_SUB_BITS)) & (STATS_SUB - 1));
+}
+
+/* Smallest value that lands in bucket i */
+static unsigned long long stats_bucket_low(int i){
+    int e;
+
+    if(i < STATS_SUB){
+	return i;
+    }
+    e = i / STATS_SUB + STATS_SUB_BITS - 1;
+    return (unsigned long long)(STATS_SUB + i % STATS_SUB) <<
+	(e - STATS_SUB_BITS);
+}
+
+/* Largest value that lands in bucket i */
+static unsigned long long stats_bucket_high(int i){
+    if(i + 1 >= STATS_BUCKETS){
+	return ~0ULL;
+    }
+    return stats_bucket_low(i + 1) - 1;
+}
+
+void stats_record(int stage, unsigned long long ns, int contended){
+    stats_hist* h;
+    int b;
+
+    if(!stats_on){
+	return;
+    }
+    if(!stats_self){
+	stats_thread_start("thread");
+	if(!stats_self){
+	    return;
+	}
+    }
+
+    /* only this thread writes its block */
+    h = &stats_self->stages[stage];
+    b = stats_bucket(ns);
+    __atomic_store_n(&h->buckets[b], h->buckets[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->totalNs, h->totalNs + ns, __ATOMIC_RELAXED);
+    if(contended){
+	__atomic_store_n(&h->contended, h->contended + 1, __ATOMIC_RELAXED);
+    }
+    if(ns > h->maxNs){
+	__atomic_store_n(&h->maxNs, ns, __ATOMIC_RELAXED);
+    }
+}
+
+void stats_lock(pthread_mutex_t* m, int stage){
+    unsigned long long start;
+
+    if(!stats_on){
+	pthread_mutex_lock(m);
+	return;
+    }
+    if(pthread_mutex_trylock(m) == 0){
+	stats_record(stage, 0, 0);
+	return;
+    }
+
+    start = stats_now_ns();
+    pthread_mutex_lock(m);
+    stats_record(stage, stats_now_ns() - start, 1);
+}
+
+/* Sum one stage over every thread */
+static void stats_merge(int stage, stats_hist* out){
+    stats_thread* t;
+    stats_hist* h;
+    unsigned long long maxNs;
+    int b;
+
+    memset(out, 0, sizeof(stats_hist));
+    for(t = __atomic_load_n(&stats_threads, __ATOMIC_ACQUIRE); t != NULL;
+	t = t->next){
+	h = &t->stages[stage];
+	out->count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+	out->contended += __atomic_load_n(&h->contended, __ATOMIC_RELAXED);
+	out->totalNs += __atomic_load_n(&h->totalNs, __ATOMIC_RELAXED);
+	maxNs = __atomic_load_n(&h->maxNs, __ATOMIC_RELAXED);
+	if(maxNs > out->maxNs){
+	    out->maxNs = maxNs;
+	}
+	for(b=0; b<STATS_BUCKETS; b++){
+	    out->buckets[b] += __atomic_load_n(&h->buckets[b],
+					       __ATOMIC_RELAXED);
+	}
+    }
+}
+
+/* Value at or below which permille of samples fall, at bucket resolution */
+static unsigned long long stats_percentile(const stats_hist* h, int permille){
+    unsigned long long want;
+    unsigned long long seen = 0;
+    int b;
+
+    if(h->count == 0){
+	return 0;
+    }
+    want = ((unsigned long long)h->count * permille + 999) / 1000;
+    for(b=0; b<STATS_BUCKETS; b++){
+	seen += h->buckets[b];
+	if(seen >= want){
+	    unsigned long long high = stats_bucket_high(b);
+	    return high < h->maxNs ? high : h->maxNs;
+	}
+    }
+    return h->maxNs;
+}
+
+static void stats_dump_text(FILE* fp, stats_hist* h){
+    stats_thread* t;
+    int s;
+
+    fprintf(fp, "Stats: %d threads\n", stats_num_threads);
+    fprintf(fp, "Stats: %-12s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+	    "stage", "count", "contended", "mean us", "p50 us", "p90 us",
+	    "p99 us", "p99.9 us", "max us");
+    for(s=0; s<STATS_STAGES; s++){
+	stats_merge(s, h);
+	fprintf(fp, "Stats: %-12s %10lu %10lu %10.1f %10.1f %10.1f %10.1f "
+		"%10.1f %10.1f\n", stats_names[s], h->count, h->contended,
+		h->count ? h->totalNs / 1e3 / h->count : 0.0,
+		stats_percentile(h, 500) / 1e3,
+		stats_percentile(h, 900) / 1e3,
+		stats_percentile(h, 990) / 1e3,
+		stats_percentile(h, 999) / 1e3,
+		h->maxNs / 1e3);
+    }
+
+    for(t = __atomic_load_n(&stats_threads, __ATOMIC_ACQUIRE); t != NULL;
+	t = t->next){
+	fprintf(fp, "Stats: %s %d:", t->role, t->id);
+	for(s=0; s<STATS_STAGES; s++){
+	    if(t->stages[s].count){
+		fprintf(fp, " %s %lu", stats_names[s],
+			__atomic_load_n(&t->stages[s].count,
+					__ATOMIC_RELAXED));
+	    }
+	}
+	fprintf(fp, "\n");
+    }
+}
+
+static void stats_dump_json(FILE* fp, stats_hist* h){
+    stats_thread* t;
+    const char* sep;
+    int s;
+    int b;
+
+    fprintf(fp, "{\"threads\":[");
+    sep = "";
+    for(t = __atomic_load_n(&stats_threads, __ATOMIC_ACQUIRE); t != NULL;
+	t = t->next){
+	fprintf(fp, "%s{\"role\":\"%s\",\"id\":%d,\"counts\":{", sep,
+		t->role, t->id);
+	for(s=0; s<STATS_STAGES; s++){
+	    fprintf(fp, "%s\"%s\":%lu", s ? "," : "", stats_names[s],
+		    __atomic_load_n(&t->stages[s].count, __ATOMIC_RELAXED));
+	}
+	fprintf(fp, "}}");
+	sep = ",";
+    }
+
+    fprintf(fp, "],\"stages\":{");
+    for(s=0; s<STATS_STAGES; s++){
+	stats_merge(s, h);
+	fprintf(fp, "%s\"%s\":{\"count\":%lu,\"contended\":%lu,"
+		"\"total_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+		"\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu,"
+		"\"buckets\":[", s ? "," : "", stats_names[s], h->count,
+		h->contended, h->totalNs, stats_percentile(h, 500),
+		stats_percentile(h, 900), stats_percentile(h, 990),
+		stats_percentile(h, 999), h->maxNs);
+	sep = "";
+	for(b=0; b<STATS_BUCKETS; b++){
+	    if(h->buckets[b]){
+		fprintf(fp, "%s[%llu,%lu]", sep, stats_bucket_low(b),
+			h->buckets[b]);
+		sep = ",";
+	    }
+	}
+	fprintf(fp, "]}");
+    }
+    fprintf(fp, "}}\n");
+}
+
+void stats_dump(FILE* fp, int json){
+    stats_hist* h;
+
+    if(!stats_on){
+	return;
+    }
+    h = malloc(sizeof(stats_hist));
+    if(!h){
+	perror("Error on stats Malloc");
+	return;
+    }
+
+    if(json){
+	stats_dump_json(fp, h);
+    }
+    else{
+	stats_dump_text(fp, h);
+    }
+    fflush(fp);
+    free(h);
+}
+
+void stats_cleanup(void){
+    stats_thread* t;
+    stats_thread* next;
+
+    for(t = stats_threads; t != NULL; t = next){
+	next = t->next;
+	free(t);
+    }
+    stats_threads = NULL;
+    stats_num_threads = 0;
+}
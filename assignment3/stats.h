@@ -0,0 +1,86 @@
+/*
+ * File: stats.h
+ * Author: Thomas Lillis
+ * Project: CSCI 3753 Programming Assignment 3
+ * Description:
+ * 	This is the header file for per-thread stage timing. Each thread
+ *      records into its own cache-line aligned block of log-linear
+ *      histograms, so recording takes no locks and threads never share
+ *      a line. A dump walks every block and merges them. Recording is
+ *      a no-op until stats_enable is called.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* Stages */
+#define STATS_QUEUE_PUSH 0
+#define STATS_QUEUE_POP 1
+#define STATS_LOOKUP 2
+#define STATS_CACHE_LOCK 3
+#define STATS_CACHE_WAIT 4
+#define STATS_OUTPUT_LOCK 5
+#define STATS_OUTPUT_WRITE 6
+/* hedge samples time a duplicate from sending to its call's answer,
+ * contended when the duplicate won; deadline samples time lookups
+ * given up on */
+#define STATS_HEDGE 7
+#define STATS_DEADLINE 8
+#define STATS_STAGES 9
+
+/* 16 buckets per power of two, about 6% resolution over all of 64 bits */
+#define STATS_SUB_BITS 4
+#define STATS_SUB (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) * STATS_SUB)
+#define STATS_LINE 64
+
+typedef struct stats_hist_s{
+    unsigned long count;
+    unsigned long contended;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+    unsigned long buckets[STATS_BUCKETS];
+} stats_hist;
+
+typedef struct stats_thread_s{
+    struct stats_thread_s* next;
+    const char* role;
+    int id;
+    stats_hist stages[STATS_STAGES];
+} __attribute__((aligned(STATS_LINE))) stats_thread;
+
+/* Function to turn recording on, before any threads start */
+void stats_enable(void);
+
+/* Function to ask whether recording is on */
+int stats_enabled(void);
+
+/* Function to give the calling thread its own block, named role
+ * Threads that record without one get a block named "thread"
+ */
+void stats_thread_start(const char* role);
+
+/* Function to get a monotonic time for stats_record */
+unsigned long long stats_now_ns(void);
+
+/* Function to add one sample of ns to a stage for the calling thread
+ * contended marks samples that had to wait
+ */
+void stats_record(int stage, unsigned long long ns, int contended);
+
+/* Function to lock m, timing the wait under stage if it was held */
+void stats_lock(pthread_mutex_t* m, int stage);
+
+/* Function to print merged stages and per-thread counts
+ * as text or, if json is set, one JSON object
+ */
+void stats_dump(FILE* fp, int json);
+
+/* Function to free every thread's block once all have exited */
+void stats_cleanup(void);
+
+#endif
@@ -10,158 +10,425 @@
  *  
  */
 
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+
 #include "util.h"
+#include "hosts.h"
+#include "fakedns.h"
 
-int dnslookup(const char* hostname, char* firstIPstr, int maxSize){
+static int gai_lookup(util_backend* b, const char* hostname,
+                      util_addr* addrs, int* num_addrs, int maxAddrs);
 
-    /* Local vars */
-    struct addrinfo* headresult = NULL;
-    struct addrinfo* result = NULL;
-    struct sockaddr_in* ipv4sock = NULL;
-    struct in_addr* ipv4addr = NULL;
-    char ipv4str[INET_ADDRSTRLEN];
-    char ipstr[INET6_ADDRSTRLEN];
+static const util_backend_ops util_gai_ops = {
+    "getaddrinfo", NULL, gai_lookup, NULL, NULL, NULL, NULL, NULL, NULL
+};
 
-    int addrError = 0;
+static const util_backend_ops* util_backends[UTIL_MAX_BACKENDS] = {
+    &util_gai_ops, &hosts_backend_ops, &fake_backend_ops
+};
+static int util_num_backends = 3;
 
-    /* DEBUG: Print Hostname*/
-#ifdef UTIL_DEBUG
-    fprintf(stderr, "%s\n", hostname);
-#endif
+static const util_profile util_default_profile = {
+    AF_UNSPEC, SOCK_STREAM, 0
+};
 
-    /* Lookup Hostname */
-    addrError = getaddrinfo(hostname, NULL, NULL, &headresult);
-    if(addrError){
-        fprintf(stderr, "Error looking up Address: %s\n",
-                gai_strerror(addrError));
+static pthread_once_t util_once = PTHREAD_ONCE_INIT;
+static util_backend util_default;
+static util_backend* util_active = NULL;
+
+/* Families with a non-loopback address, for addrconfig */
+static pthread_once_t util_ifaddrs_once = PTHREAD_ONCE_INIT;
+static int util_have_inet = 0;
+static int util_have_inet6 = 0;
+
+static long long util_now_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int util_backend_register(const util_backend_ops* ops){
+    if(util_num_backends == UTIL_MAX_BACKENDS){
         return UTIL_FAILURE;
     }
-    /* Loop Through result Linked List */
-    for(result=headresult; result != NULL; result = result->ai_next){
-        /* Extract IP Address and Convert to String */
-        if(result->ai_addr->sa_family == AF_INET){
-            /* IPv4 Address Handling */
-            ipv4sock = (struct sockaddr_in*)(result->ai_addr);
-            ipv4addr = &(ipv4sock->sin_addr);
-            if(!inet_ntop(result->ai_family, ipv4addr,
-                        ipv4str, sizeof(ipv4str))){
-                perror("Error Converting IP to String");
-                return UTIL_FAILURE;
-            }
-#ifdef UTIL_DEBUG
-            fprintf(stdout, "%s\n", ipv4str);
-#endif
-            strncpy(ipstr, ipv4str, sizeof(ipstr));
-            ipstr[sizeof(ipstr)-1] = '\0';
+    util_backends[util_num_backends++] = ops;
+    return UTIL_SUCCESS;
+}
+
+int util_backend_open(util_backend* b, const char* spec){
+    const char* arg = strchr(spec, ':');
+    size_t nameLen = arg ? (size_t)(arg - spec) : strlen(spec);
+    int i;
+
+    b->ops = NULL;
+    b->state = NULL;
+    b->profile = util_default_profile;
+    for(i=0; i<util_num_backends; i++){
+        if(strlen(util_backends[i]->name) == nameLen &&
+           strncmp(util_backends[i]->name, spec, nameLen) == 0){
+            b->ops = util_backends[i];
+            break;
         }
-        else if(result->ai_addr->sa_family == AF_INET6){
-            /* IPv6 Handling */
-#ifdef UTIL_DEBUG
-            fprintf(stdout, "IPv6 Address: Not Handled\n");
-#endif
-            strncpy(ipstr, "UNHANDLED", sizeof(ipstr));
-            ipstr[sizeof(ipstr)-1] = '\0';
+    }
+    if(!b->ops){
+        fprintf(stderr, "Unknown resolver backend: %s\n", spec);
+        return UTIL_FAILURE;
+    }
+
+    if(b->ops->open && b->ops->open(b, arg ? arg + 1 : NULL)){
+        fprintf(stderr, "Error opening resolver backend: %s\n", spec);
+        b->ops = NULL;
+        return UTIL_FAILURE;
+    }
+    return UTIL_SUCCESS;
+}
+
+void util_backend_close(util_backend* b){
+    if(b->ops && b->ops->destroy){
+        b->ops->destroy(b);
+    }
+    b->ops = NULL;
+    b->state = NULL;
+}
+
+int util_profile_parse(util_profile* p, const char* spec){
+    const char* end;
+    size_t len;
+
+    *p = util_default_profile;
+    while(*spec){
+        end = strchr(spec, ',');
+        len = end ? (size_t)(end - spec) : strlen(spec);
+        if(len == 1 && strncmp(spec, "a", len) == 0){
+            p->family = AF_INET;
+        }
+        else if(len == 4 && strncmp(spec, "aaaa", len) == 0){
+            p->family = AF_INET6;
+        }
+        else if(len == 4 && strncmp(spec, "dual", len) == 0){
+            p->family = AF_UNSPEC;
+        }
+        else if(len == 6 && strncmp(spec, "stream", len) == 0){
+            p->socktype = SOCK_STREAM;
+        }
+        else if(len == 5 && strncmp(spec, "dgram", len) == 0){
+            p->socktype = SOCK_DGRAM;
+        }
+        else if(len == 3 && strncmp(spec, "raw", len) == 0){
+            p->socktype = SOCK_RAW;
+        }
+        else if(len == 3 && strncmp(spec, "any", len) == 0){
+            p->socktype = 0;
+        }
+        else if(len == 10 && strncmp(spec, "addrconfig", len) == 0){
+            p->addrconfig = 1;
         }
         else{
-            /* Unhandlded Protocol Handling */
-#ifdef UTIL_DEBUG
-            fprintf(stdout, "Unknown Protocol: Not Handled\n");
-#endif
-            strncpy(ipstr, "UNHANDELED", sizeof(ipstr));
-            ipstr[sizeof(ipstr)-1] = '\0';
+            fprintf(stderr, "Unknown query profile setting: %.*s\n",
+                    (int)len, spec);
+            return UTIL_FAILURE;
+        }
+        spec += end ? len + 1 : len;
+    }
+    return UTIL_SUCCESS;
+}
+
+void util_backend_set_profile(util_backend* b, const util_profile* p){
+    b->profile = *p;
+}
+
+static void util_read_ifaddrs(void){
+    struct ifaddrs* head;
+    struct ifaddrs* ifa;
+
+    if(getifaddrs(&head)){
+        util_have_inet = 1;
+        util_have_inet6 = 1;
+        return;
+    }
+    for(ifa = head; ifa != NULL; ifa = ifa->ifa_next){
+        if(!ifa->ifa_addr || (ifa->ifa_flags & IFF_LOOPBACK)){
+            continue;
         }
-        /* Save First IP Address */
-        if(result==headresult){
-            strncpy(firstIPstr, ipstr, maxSize);
-            firstIPstr[maxSize-1] = '\0';
+        if(ifa->ifa_addr->sa_family == AF_INET){
+            util_have_inet = 1;
+        }
+        else if(ifa->ifa_addr->sa_family == AF_INET6){
+            util_have_inet6 = 1;
         }
     }
+    freeifaddrs(head);
 
-    /* Cleanup */
-    freeaddrinfo(headresult);
+    if(!util_have_inet && !util_have_inet6){
+        util_have_inet = 1;
+        util_have_inet6 = 1;
+    }
+}
+
+int util_profile_wants(const util_profile* p, int family){
+    if(p->family != AF_UNSPEC){
+        return p->family == family;
+    }
+    if(!p->addrconfig){
+        return 1;
+    }
+    pthread_once(&util_ifaddrs_once, util_read_ifaddrs);
+    return family == AF_INET ? util_have_inet : util_have_inet6;
+}
+
+static void util_open_default(void){
+    const char* spec = getenv("UTIL_BACKEND");
+
+    if(!spec || util_backend_open(&util_default, spec)){
+        util_backend_open(&util_default, UTIL_DEFAULT_BACKEND);
+    }
+}
+
+void util_set_backend(util_backend* b){
+    util_active = b;
+}
+
+util_backend* util_get_backend(void){
+    if(util_active){
+        return util_active;
+    }
+    pthread_once(&util_once, util_open_default);
+    return &util_default;
+}
+
+int util_async_init(util_async* a, util_backend* b, int maxInflight){
+    a->backend = b;
+    a->maxInflight = maxInflight > 0 ? maxInflight : 1;
+    a->state = NULL;
+    a->done = NULL;
+    a->head = 0;
+    a->count = 0;
+
+    if(b->ops->async_open){
+        return b->ops->async_open(a);
+    }
+
+    a->done = malloc(sizeof(util_answer) * a->maxInflight);
+    if(!a->done){
+        perror("Error on async Malloc");
+        return UTIL_FAILURE;
+    }
+    return UTIL_SUCCESS;
+}
+
+int util_async_submit(util_async* a, const char* name, size_t len,
+                      void* user){
+    char hostname[UTIL_MAX_NAME + 1];
+    util_answer* answer;
+    long long start;
+
+    if(a->backend->ops->submit){
+        return a->backend->ops->submit(a, name, len, user);
+    }
+    if(a->count == a->maxInflight || len > UTIL_MAX_NAME){
+        return UTIL_FAILURE;
+    }
+
+    /* No async support, look it up now and queue the answer */
+    memcpy(hostname, name, len);
+    hostname[len] = '\0';
+    answer = &a->done[(a->head + a->count) % a->maxInflight];
+    answer->num_addrs = 0;
+    start = util_now_ms();
+    answer->status = a->backend->ops->lookup(a->backend, hostname,
+                                             answer->addrs,
+                                             &answer->num_addrs,
+                                             UTIL_MAX_ADDRS);
+    answer->elapsedMs = util_now_ms() - start;
+    answer->user = user;
+    if(answer->status != UTIL_SUCCESS){
+        answer->num_addrs = 0;
+    }
+    a->count++;
+
+    return UTIL_SUCCESS;
+}
+
+int util_async_poll(util_async* a, util_answer* answers, int max,
+                    int timeoutMs){
+    int n = 0;
+
+    if(a->backend->ops->poll){
+        return a->backend->ops->poll(a, answers, max, timeoutMs);
+    }
+
+    /* Nothing will finish while we wait, so just sleep like a poll */
+    if(a->count == 0){
+        usleep(timeoutMs * 1000);
+        return 0;
+    }
+    while(n < max && a->count > 0){
+        answers[n++] = a->done[a->head];
+        a->head = (a->head + 1) % a->maxInflight;
+        a->count--;
+    }
+    return n;
+}
+
+int util_async_inflight(util_async* a){
+    if(a->backend->ops->inflight){
+        return a->backend->ops->inflight(a);
+    }
+    return a->count;
+}
+
+void util_async_cleanup(util_async* a){
+    if(a->backend->ops->async_close){
+        a->backend->ops->async_close(a);
+    }
+    free(a->done);
+    a->done = NULL;
+    a->state = NULL;
+}
+
+int util_addr_add(util_addr* addrs, int num_addrs, int maxAddrs,
+                  int family, const void* addr){
+    size_t size = family == AF_INET6 ? 16 : 4;
+    int i;
+
+    for(i=0; i<num_addrs; i++){
+        if(addrs[i].family == family &&
+           memcmp(addrs[i].addr, addr, size) == 0){
+            return num_addrs;
+        }
+    }
+    if(num_addrs == maxAddrs){
+        return num_addrs;
+    }
+    addrs[num_addrs].family = family;
+    memcpy(addrs[num_addrs].addr, addr, size);
+
+    return num_addrs + 1;
+}
+
+size_t util_addr_format(const util_addr* addr, char* out){
+    if(!inet_ntop(addr->family, addr->addr, out, INET6_ADDRSTRLEN)){
+        out[0] = '\0';
+        return 0;
+    }
+    return strlen(out);
+}
+
+int util_lookup(const char* hostname, util_addr* addrs, int* num_addrs,
+                int maxAddrs){
+    util_backend* b = util_get_backend();
+
+    *num_addrs = 0;
+    return b->ops->lookup(b, hostname, addrs, num_addrs, maxAddrs);
+}
+
+int dnslookup(const char* hostname, char* firstIPstr, int maxSize){
+    util_addr first;
+    char ip[INET6_ADDRSTRLEN];
+    int num_addrs = 0;
+
+    /* Every Backend Answers With Its First Address */
+    if(util_lookup(hostname, &first, &num_addrs, 1) != UTIL_SUCCESS){
+        return UTIL_FAILURE;
+    }
+    ip[0] = '\0';
+    if(num_addrs > 0){
+        util_addr_format(&first, ip);
+    }
+    strncpy(firstIPstr, ip, maxSize);
+    firstIPstr[maxSize-1] = '\0';
 
     return UTIL_SUCCESS;
 }
+
 int mydnslookup(const char* hostname, char ips[MAX_IPS][INET6_ADDRSTRLEN], int * num_ips, int maxSize){
+    util_addr addrs[UTIL_MAX_ADDRS];
+    char ip[INET6_ADDRSTRLEN];
+    int num_addrs = 0;
+    int status;
+    int i;
+
+    /* Text Only For Callers That Still Want It */
+    status = util_lookup(hostname, addrs, &num_addrs, UTIL_MAX_ADDRS);
+    for(i=0; i<num_addrs; i++){
+        util_addr_format(&addrs[i], ip);
+        strncpy(ips[i], ip, maxSize);
+        ips[i][maxSize-1] = '\0';
+    }
+    *num_ips = num_addrs;
+
+    return status;
+}
+
+static int gai_lookup(util_backend* b, const char* hostname,
+                      util_addr* addrs, int* num_addrs, int maxAddrs){
 
     /* Local vars */
+    struct addrinfo hints;
     struct addrinfo* headresult = NULL;
     struct addrinfo* result = NULL;
-    struct sockaddr_in* ipv4sock = NULL;
-    struct sockaddr_in6* ipv6sock = NULL;
-    struct in_addr* ipv4addr = NULL;
-    struct in6_addr* ipv6addr = NULL;
-    char ipv4str[INET_ADDRSTRLEN];
-    char ipv6str[INET6_ADDRSTRLEN];
-    char ipstr[INET6_ADDRSTRLEN];
+    const void* addr = NULL;
     int addrError = 0;
-    int i = 0;
+    int n = 0;
 
     /* DEBUG: Print Hostname*/
 #ifdef UTIL_DEBUG
     fprintf(stderr, "%s\n", hostname);
 #endif
 
+    /* Ask Only For The Profile, One Entry Per Address */
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = b->profile.family;
+    hints.ai_socktype = b->profile.socktype;
+    hints.ai_flags = b->profile.addrconfig ? AI_ADDRCONFIG : 0;
+
     /* Lookup Hostname */
-    addrError = getaddrinfo(hostname, NULL, NULL, &headresult);
+    addrError = getaddrinfo(hostname, NULL, &hints, &headresult);
     if(addrError){
         fprintf(stderr, "Error looking up Address: %s\n",
                 gai_strerror(addrError));
+        if(addrError == EAI_NONAME
+#ifdef EAI_NODATA
+           || addrError == EAI_NODATA
+#endif
+#ifdef EAI_ADDRFAMILY
+           || addrError == EAI_ADDRFAMILY
+#endif
+            ){
+            return UTIL_NOTFOUND;
+        }
+        if(addrError == EAI_AGAIN){
+            return UTIL_TIMEOUT;
+        }
         return UTIL_FAILURE;
     }
-    /* Loop Through result Linked List */
+    /* Loop Through result Linked List, Keeping Raw Addresses Once */
     for(result=headresult; result != NULL; result = result->ai_next){
-        if(i == MAX_IPS) {
-            break;
-        }
-        /* Extract IP Address and Convert to String */
         if(result->ai_addr->sa_family == AF_INET){
             /* IPv4 Address Handling */
-            ipv4sock = (struct sockaddr_in*)(result->ai_addr);
-            ipv4addr = &(ipv4sock->sin_addr);
-            if(!inet_ntop(result->ai_family, ipv4addr,
-                        ipv4str, sizeof(ipv4str))){
-                perror("Error Converting IP to String");
-                return UTIL_FAILURE;
-            }
-#ifdef UTIL_DEBUG
-            fprintf(stdout, "%s\n", ipv4str);
-#endif
-            strncpy(ipstr, ipv4str, sizeof(ipstr));
-            ipstr[sizeof(ipstr)-1] = '\0';
-            strncpy(ips[i], ipstr, maxSize);
-            ips[i][maxSize-1] = '\0';
-            i++;
+            addr = &((struct sockaddr_in*)(result->ai_addr))->sin_addr;
         }
         else if(result->ai_addr->sa_family == AF_INET6){
             /* IPv6 Handling */
-#ifdef UTIL_DEBUG
-            fprintf(stdout, "IPv6 Address: Not Handled\n");
-#endif
-            ipv6sock = (struct sockaddr_in6*)(result->ai_addr);
-            ipv6addr = &(ipv6sock->sin6_addr);
-            if(!inet_ntop(result->ai_family, ipv6addr,
-                        ipv6str, sizeof(ipv6str))){
-                perror("Error Converting IP to String");
-                return UTIL_FAILURE;
-            }
-            strncpy(ipstr, ipv6str, sizeof(ipstr));
-            ipstr[sizeof(ipstr)-1] = '\0';
-            strncpy(ips[i], ipstr, maxSize);
-            ips[i][maxSize-1] = '\0';
-            i++;
+            addr = &((struct sockaddr_in6*)(result->ai_addr))->sin6_addr;
         }
         else{
             /* Unhandlded Protocol Handling */
 #ifdef UTIL_DEBUG
             fprintf(stdout, "Unknown Protocol: Not Handled\n");
 #endif
-            //strncpy(ipstr, "UNHANDELED", sizeof(ipstr));
-            //ipstr[sizeof(ipstr)-1] = '\0';
+            freeaddrinfo(headresult);
             return UTIL_FAILURE;
         }
+        n = util_addr_add(addrs, n, maxAddrs, result->ai_addr->sa_family,
+                          addr);
     }
-    *num_ips = i;
+    *num_addrs = n;
     /* Cleanup */
     freeaddrinfo(headresult);
 
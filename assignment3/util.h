@@ -28,12 +28,88 @@
 
 #define UTIL_FAILURE -1
 #define UTIL_SUCCESS 0
+/* mydnslookup failures with a known cause */
+#define UTIL_NOTFOUND -2
+#define UTIL_TIMEOUT -3
 
 #define MAX_IPS 100
 
+#define UTIL_MAX_ADDRS 32
+#define UTIL_MAX_NAME 1024
+#define UTIL_MAX_BACKENDS 8
+#define UTIL_DEFAULT_BACKEND "getaddrinfo"
+#define UTIL_DEFAULT_PROFILE "dual,stream"
+
+/* One raw address of a lookup, only the first 4 bytes for AF_INET */
+typedef struct util_addr_s{
+    int family;
+    unsigned char addr[16];
+} util_addr;
+
+/* One finished asynchronous lookup */
+typedef struct util_answer_s{
+    void* user;
+    int status;
+    long long elapsedMs;
+    int num_addrs;
+    util_addr addrs[UTIL_MAX_ADDRS];
+} util_answer;
+
+/* Which addresses a lookup asks for
+ * family is AF_UNSPEC for both, AF_INET or AF_INET6
+ * socktype is the one socket type getaddrinfo answers for, 0 for every
+ * type, which repeats each address once per type
+ * addrconfig drops families with no address configured on this host
+ */
+typedef struct util_profile_s{
+    int family;
+    int socktype;
+    int addrconfig;
+} util_profile;
+
+typedef struct util_backend_s util_backend;
+typedef struct util_async_s util_async;
+
+/* Operations of a resolver backend
+ * lookup blocks the calling thread, filling the caller's addrs as
+ * util_lookup does; the async operations keep many
+ * lookups in flight on one util_async per thread. Backends without
+ * async operations leave them NULL and util_async runs each lookup
+ * at submit time instead.
+ */
+typedef struct util_backend_ops_s{
+    const char* name;
+    int (*open)(util_backend* b, const char* arg);
+    int (*lookup)(util_backend* b, const char* hostname,
+		  util_addr* addrs, int* num_addrs, int maxAddrs);
+    int (*async_open)(util_async* a);
+    int (*submit)(util_async* a, const char* name, size_t len, void* user);
+    int (*poll)(util_async* a, util_answer* answers, int max,
+		int timeoutMs);
+    int (*inflight)(util_async* a);
+    void (*async_close)(util_async* a);
+    void (*destroy)(util_backend* b);
+} util_backend_ops;
+
+struct util_backend_s{
+    const util_backend_ops* ops;
+    void* state;
+    util_profile profile;
+};
+
+struct util_async_s{
+    util_backend* backend;
+    int maxInflight;
+    void* state;
+    /* lookups run at submit, waiting to be polled */
+    util_answer* done;
+    int head;
+    int count;
+};
+
 /* Fuction to return the first IP address found
- * for hostname. IP address returned as string
- * firstIPstr of size maxsize
+ * for hostname, as util_lookup orders them. IP address returned
+ * as string firstIPstr of size maxsize
  */
 int dnslookup(const char* hostname,
 	      char* firstIPstr,
@@ -42,5 +118,96 @@ int mydnslookup(const char* hostname,
 	      char ips[MAX_IPS][INET6_ADDRSTRLEN],
           int * num_ips,
 	      int maxSize);
+/* mydnslookup returns UTIL_NOTFOUND if the name does not exist,
+ * UTIL_TIMEOUT if the resolver did not answer in time and
+ * UTIL_FAILURE for any other error
+ */
+
+/* Function to lookup hostname into the caller's addrs, holding at
+ * most maxAddrs raw addresses without repeats. Nothing is allocated or
+ * converted to text, so one buffer can be reused for every lookup.
+ * Returns UTIL_SUCCESS or a failure status as for mydnslookup
+ */
+int util_lookup(const char* hostname, util_addr* addrs, int* num_addrs,
+		int maxAddrs);
+
+/* Function to add the address at addr to addrs unless it is there
+ * Returns the new count, unchanged for a repeat or when full
+ */
+int util_addr_add(util_addr* addrs, int num_addrs, int maxAddrs,
+		  int family, const void* addr);
+
+/* Function to write addr as text into out of INET6_ADDRSTRLEN bytes
+ * Returns the length written
+ */
+size_t util_addr_format(const util_addr* addr, char* out);
+
+/* All lookups go through the active backend. Until one is set it is
+ * opened from $UTIL_BACKEND, or getaddrinfo if that is unset.
+ */
+
+/* Function to add a backend to those util_backend_open knows
+ * Built in: getaddrinfo, hosts:<file>, fake[:latencyUs[:failPercent]]
+ * Returns UTIL_SUCCESS or UTIL_FAILURE if the table is full
+ */
+int util_backend_register(const util_backend_ops* ops);
+
+/* Function to open a backend from a "name[:arg]" spec, with the
+ * UTIL_DEFAULT_PROFILE query profile
+ * Returns UTIL_SUCCESS or UTIL_FAILURE
+ */
+int util_backend_open(util_backend* b, const char* spec);
+
+/* Function to parse a comma separated query profile:
+ * a, aaaa or dual; stream, dgram, raw or any; addrconfig
+ * Unnamed settings keep their UTIL_DEFAULT_PROFILE values
+ * Returns UTIL_SUCCESS or UTIL_FAILURE
+ */
+int util_profile_parse(util_profile* p, const char* spec);
+
+/* Function to set the profile of lookups on b, taking effect for
+ * async lookups started after it
+ */
+void util_backend_set_profile(util_backend* b, const util_profile* p);
+
+/* Function to check if lookups with profile p return family addresses
+ * addrconfig only narrows a dual profile, so at least one family is
+ * always wanted; a host with only loopback addresses keeps both
+ * Returns 1 if they do, 0 if not
+ */
+int util_profile_wants(const util_profile* p, int family);
+
+/* Function to close a backend opened by util_backend_open */
+void util_backend_close(util_backend* b);
+
+/* Function to make b the backend dnslookup and mydnslookup use */
+void util_set_backend(util_backend* b);
+
+/* Function to get the active backend, opening the default if unset */
+util_backend* util_get_backend(void);
+
+/* Function to start asynchronous lookups on b for one thread
+ * Returns UTIL_SUCCESS or UTIL_FAILURE
+ */
+int util_async_init(util_async* a, util_backend* b, int maxInflight);
+
+/* Function to start a lookup of len bytes of name
+ * user is handed back with the answer
+ * Returns UTIL_SUCCESS, or UTIL_FAILURE if full or the name is invalid
+ */
+int util_async_submit(util_async* a, const char* name, size_t len,
+		      void* user);
+
+/* Function to wait up to timeoutMs for answers
+ * Returns the number filled, at most max, or UTIL_FAILURE
+ */
+int util_async_poll(util_async* a, util_answer* answers, int max,
+		    int timeoutMs);
+
+/* Function to count lookups submitted and not yet polled */
+int util_async_inflight(util_async* a);
+
+/* Function to stop asynchronous lookups, dropping any in flight */
+void util_async_cleanup(util_async* a);
 
 #endif